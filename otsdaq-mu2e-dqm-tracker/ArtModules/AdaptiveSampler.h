@@ -0,0 +1,96 @@
+// Chooses the fraction of events the DQM analyzes so that its processing stays
+// within a CPU budget: fraction = budget * (mean time between events) / (mean
+// DQM cost per event), both exponentially weighted. Events are picked with a
+// deterministic accumulator, so exactly that fraction is taken, evenly spread.
+// Histograms are filled with weight 1/fraction to keep rates normalized; an
+// accepted event dropped later (DQM queue full) lowers the fraction in effect.
+#ifndef _AdaptiveSampler_h_
+#define _AdaptiveSampler_h_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace ots {
+
+  class AdaptiveSampler {
+  public:
+    // cpuBudget: cores the DQM may use (0.5 = half a core); 0 disables sampling
+    AdaptiveSampler(double cpuBudget, double alpha, double minFraction)
+      : budget_(cpuBudget), alpha_(alpha), minFraction_(minFraction) { reset(); }
+
+    bool enabled() const { return budget_ > 0; }
+
+    // Called for every incoming event with its arrival time; true if the event
+    // is to be analyzed, with weight() as the weight of its histogram entries
+    bool accept(uint64_t nowNs) {
+      ++seen_;
+      if (!enabled()) return true;
+      if (lastArrivalNs_ > 0) {
+	double dt = double(nowNs - lastArrivalNs_);
+	intervalNs_ = intervalNs_ > 0 ? intervalNs_ + alpha_ * (dt - intervalNs_) : dt;
+      }
+      lastArrivalNs_ = nowNs;
+
+      double cost = costNs_.load(std::memory_order_relaxed);
+      if (cost > 0 && intervalNs_ > 0) {
+	fraction_ = std::min(1., std::max(minFraction_, budget_ * intervalNs_ / cost));
+      }
+      accumulator_ += fraction_;
+      if (accumulator_ < 1.) return false;
+      accumulator_ -= 1.;
+      ++accepted_;
+      kept_ += alpha_ * (1. - kept_);  // taken back by dropped()
+      return true;
+    }
+
+    // The event last accepted was not analyzed after all: it is no longer
+    // counted, and the share of accepted events that are analyzed, averaged
+    // like the cost, scales the weight of the next ones
+    void dropped() {
+      --accepted_;
+      kept_ -= alpha_;
+    }
+
+    // Cost of one analyzed event; may be called from another thread than accept
+    void processed(uint64_t costNs) {
+      double cost = costNs_.load(std::memory_order_relaxed);
+      cost = cost > 0 ? cost + alpha_ * (double(costNs) - cost) : double(costNs);
+      costNs_.store(cost, std::memory_order_relaxed);
+    }
+
+    // fraction of the incoming events analyzed, drops included
+    double   fraction() const { return std::max(minFraction_, fraction_ * kept_); }
+    double   weight() const { return 1. / fraction(); }
+    double   costNs() const { return costNs_.load(std::memory_order_relaxed); }
+    double   intervalNs() const { return intervalNs_; }
+    uint64_t seen() const { return seen_; }
+    uint64_t accepted() const { return accepted_; }
+
+    void reset() {
+      fraction_ = 1.;
+      accumulator_ = 0.;
+      kept_ = 1.;
+      intervalNs_ = 0.;
+      lastArrivalNs_ = 0;
+      seen_ = accepted_ = 0;
+      costNs_.store(0., std::memory_order_relaxed);
+    }
+
+  private:
+    double              budget_;
+    double              alpha_;
+    double              minFraction_;
+    double              fraction_;
+    double              accumulator_;
+    double              kept_;
+    double              intervalNs_;
+    uint64_t            lastArrivalNs_;
+    uint64_t            seen_;
+    uint64_t            accepted_;
+    std::atomic<double> costNs_;
+  };
+
+} // namespace ots
+
+#endif
@@ -66,10 +66,10 @@
 
 // OTS:
 #include "otsdaq-mu2e-dqm-tracker/ArtModules/OccupancyRootObjects.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/PublishHub.hh"
 #include "otsdaq/Macros/CoutMacros.h"
 #include "otsdaq/Macros/ProcessorPluginMacros.h"
 #include "otsdaq/MessageFacility/MessageFacility.h"
-#include "otsdaq/NetworkUtilities/TCPPublishServer.h"
 // C++:
 #include <algorithm>
 #include <functional>
@@ -135,7 +135,9 @@ private:
   const mu2e::HelixSeedCollection *HelCol;
   const art::Event *_event;
   OccupancyRootObjects *rootobjects = new OccupancyRootObjects("bm_plots");
-  TCPPublishServer *tcp;
+  std::shared_ptr<PublishHub> hub_;
+  std::string topic_;
+  HistoSpecTable histoSpecs_;
   void findTrigIndex(std::vector<trigInfo_> &Vec, std::string &ModuleLabel,
                      int &Index);
 };
@@ -161,7 +163,13 @@ ots::BeamMonitor::BeamMonitor(fhicl::ParameterSet const &pset)
       _nProcess(pset.get<float>("nEventsProcessed", 1.)),
       _nTrackTrig(pset.get<size_t>("nTrackTriggers", 4)),
       _nCaloTrig(pset.get<size_t>("nCaloTriggers", 4)),
-      tcp(new TCPPublishServer(pset.get<int>("listenPort", 6000))) {
+      hub_(PublishHub::get(pset.get<int>("listenPort", 6000),
+                           pset.get<size_t>("maxClientQueueBytes", 64 << 20))),
+      topic_(pset.get<std::string>("topic", "BeamMonitor")) {
+  for (const std::string &error : histoSpecs_.load(pset.get<fhicl::ParameterSet>(
+           "histoBinning", fhicl::ParameterSet()))) {
+    TLOG(TLVL_ERROR) << "histoBinning: " << error << ", keeping the default";
+  }
   TLOG(TLVL_INFO) << "Occuapncy Plotter construction is beginning ";
 
   TLOG(TLVL_DEBUG) << "TriggerRate Plotter construction complete";
@@ -171,7 +179,7 @@ ots::BeamMonitor::~BeamMonitor() {}
 
 void ots::BeamMonitor::beginJob() {
   TLOG(TLVL_INFO) << "Started";
-  rootobjects->BookHistos(tfs, _nTrackTrig, _nCaloTrig);
+  rootobjects->BookHistos(tfs, _nTrackTrig, _nCaloTrig, histoSpecs_);
 }
 
 void ots::BeamMonitor::analyze(art::Event const &event) {
@@ -249,7 +257,8 @@ void ots::BeamMonitor::analyze(art::Event const &event) {
             message.WriteObject(
                 rootobjects->Hist._hOccInfo[0][0]); // TODO - make the consumer
                                                     // see allhistograms
-            tcp->broadcastPacket(message.Buffer(), message.Length());
+            if (hub_)
+              hub_->publish(topic_, message.Buffer(), message.Length());
           }
         }
       }
@@ -271,7 +280,10 @@ void ots::BeamMonitor::findTrigIndex(std::vector<trigInfo_> &Vec,
   }
 }
 
-void ots::BeamMonitor::endJob() { TLOG(TLVL_INFO) << "Completed"; }
+void ots::BeamMonitor::endJob() {
+  hub_.reset();
+  TLOG(TLVL_INFO) << "Completed";
+}
 
 void ots::BeamMonitor::beginRun(const art::Run &run) {}
 
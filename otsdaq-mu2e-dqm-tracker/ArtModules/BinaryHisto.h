@@ -0,0 +1,416 @@
+// Compact binary wire format for the DQM histograms, an alternative to
+// streaming TH1 objects through TBufferFile. A frame is a FrameHeader followed
+// by one record per histogram:
+//
+//   RecordHeader   dimension, content type, binning, statistics
+//   group, name, title  (not terminated, padded to 8 bytes)
+//   x edges, y edges    (doubles, variable binning only)
+//   bin contents        (ncells floats or doubles, under/overflows included)
+//   sum of w2           (ncells doubles, only when the histogram has them)
+//   bin labels          (only for labelled axes: for every x bin, then every y
+//                        bin, a uint16 length and the label, "" when unset;
+//                        padded to 8 bytes)
+//
+// The contents are the TArrayF/TArrayD of the histogram copied as one block,
+// with no class metadata. Numbers are in host byte order: kMagic read
+// byte-swapped tells a receiver the frame comes from a machine of the other
+// endianness. BinaryHisto::Reader walks a received frame in place; the views
+// it gives out point into the frame, and toTH1 builds the ROOT object only where
+// one is needed. TH1F/D and TH2F/D keep their exact content type; other
+// histogram classes are sent as doubles and come back as TH1D/TH2D.
+#ifndef _BinaryHisto_h_
+#define _BinaryHisto_h_
+
+#include <TH1D.h>
+#include <TH1F.h>
+#include <TH2D.h>
+#include <TH2F.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ots {
+
+  namespace BinaryHisto {
+
+    const uint32_t kMagic   = 0x46484f42;  // "BOHF" in a little-endian dump
+    const uint16_t kVersion = 1;
+
+    enum Content : uint8_t { kFloat = 0, kDouble = 1 };
+    enum Flags : uint8_t { kVariableX = 1, kVariableY = 2, kSumw2 = 4, kLabels = 8 };
+
+    // sumw, sumw2, sumwx, sumwx2, sumwy, sumwy2, sumwxy: TH1::GetStats order
+    const int kStats = 7;
+
+    // most bins per axis: TAxis counts bins, under/overflow included, in int
+    const uint32_t kMaxBins = INT_MAX - 2;
+
+    struct FrameHeader {
+      uint32_t magic;
+      uint16_t version;
+      uint16_t flags;         // 0: uncompressed records follow
+      uint32_t records;
+      uint32_t reserved;
+      uint64_t payloadBytes;  // bytes after this header
+    };
+
+    struct RecordHeader {
+      uint32_t recordBytes;   // header included, multiple of 8
+      uint8_t  dimension;     // 1 or 2
+      uint8_t  content;       // Content
+      uint8_t  flags;         // Flags
+      uint8_t  reserved;
+      uint16_t groupLength;
+      uint16_t nameLength;
+      uint16_t titleLength;
+      uint16_t reserved2;
+      uint32_t nx;
+      uint32_t ny;            // 0 for 1D histograms
+      double   xmin, xmax, ymin, ymax;
+      double   entries;
+      double   stats[kStats];
+    };
+
+    static_assert(sizeof(FrameHeader) == 24, "FrameHeader layout");
+    static_assert(sizeof(RecordHeader) == 120, "RecordHeader layout");
+
+    inline size_t padded(size_t n) { return (n + 7) & ~size_t(7); }
+
+    // Zero-copy view of one record inside a received frame
+    class View {
+    public:
+      View() : record_(nullptr) {}
+      explicit View(const char* record) : record_(record) {
+	std::memcpy(&header_, record, sizeof(header_));
+      }
+
+      const RecordHeader& header() const { return header_; }
+      std::string group() const { return std::string(strings_(), header_.groupLength); }
+      std::string name() const {
+	return std::string(strings_() + header_.groupLength, header_.nameLength);
+      }
+      std::string title() const {
+	return std::string(strings_() + header_.groupLength + header_.nameLength, header_.titleLength);
+      }
+
+      int    dimension() const { return header_.dimension; }
+      int    nx() const { return header_.nx; }
+      int    ny() const { return header_.ny; }
+      size_t cells() const { return size_t(header_.nx + 2) * (header_.ny > 0 ? header_.ny + 2 : 1); }
+
+      // nullptr for uniform binning
+      const char* xEdges() const { return header_.flags & kVariableX ? edges_() : nullptr; }
+      const char* yEdges() const {
+	return header_.flags & kVariableY ? edges_() + xEdgeBytes_() : nullptr;
+      }
+
+      // raw bin block: cells() floats or doubles, see header().content
+      const char* contents() const { return edges_() + xEdgeBytes_() + yEdgeBytes_(); }
+      size_t      contentBytes() const {
+	return cells() * (header_.content == kFloat ? sizeof(float) : sizeof(double));
+      }
+      const char* sumw2() const {
+	return header_.flags & kSumw2 ? contents() + padded(contentBytes()) : nullptr;
+      }
+
+      // Labels of the x bins 1..nx and y bins 1..ny; false when the record has none
+      bool labels(std::vector<std::string>& x, std::vector<std::string>& y) const {
+	uint32_t bytes;
+	std::memcpy(&bytes, record_, sizeof(bytes));
+	return header_.flags & kLabels && walkLabels_(record_ + bytes, &x, &y) != nullptr;
+      }
+
+      // ROOT global bin numbering; reads through memcpy, so frames need no alignment
+      double content(size_t cell) const {
+	if (header_.content == kFloat) {
+	  float v;
+	  std::memcpy(&v, contents() + cell * sizeof(float), sizeof(v));
+	  return v;
+	}
+	double v;
+	std::memcpy(&v, contents() + cell * sizeof(double), sizeof(v));
+	return v;
+      }
+      double content(int binx, int biny) const { return content(size_t(biny) * (header_.nx + 2) + binx); }
+
+    private:
+      friend class Reader;
+
+      const char* labels_() const {
+	return contents() + padded(contentBytes()) + (header_.flags & kSumw2 ? cells() * sizeof(double) : 0);
+      }
+
+      // end of the label block, nullptr when it runs past `end`; collects the
+      // labels when given vectors
+      const char* walkLabels_(const char* end, std::vector<std::string>* x, std::vector<std::string>* y) const {
+	const char* p = labels_();
+	for (int axis = 0; axis < 2; ++axis) {
+	  std::vector<std::string>* out = axis == 0 ? x : y;
+	  uint32_t                  n   = axis == 0 ? header_.nx : header_.ny;
+	  if (out) out->resize(n);
+	  for (uint32_t i = 0; i < n; ++i) {
+	    uint16_t length;
+	    if (size_t(end - p) < sizeof(length)) return nullptr;
+	    std::memcpy(&length, p, sizeof(length));
+	    p += sizeof(length);
+	    if (size_t(end - p) < length) return nullptr;
+	    if (out) (*out)[i].assign(p, length);
+	    p += length;
+	  }
+	}
+	return p;
+      }
+
+      const char* strings_() const { return record_ + sizeof(RecordHeader); }
+      const char* edges_() const {
+	return strings_() + padded(header_.groupLength + header_.nameLength + header_.titleLength);
+      }
+      size_t xEdgeBytes_() const { return header_.flags & kVariableX ? (header_.nx + 1) * sizeof(double) : 0; }
+      size_t yEdgeBytes_() const { return header_.flags & kVariableY ? (header_.ny + 1) * sizeof(double) : 0; }
+
+      const char*  record_;
+      RecordHeader header_;
+    };
+
+    // Iterates over the records of a frame, checking every length against the buffer
+    class Reader {
+    public:
+      Reader(const char* data, size_t size) : end_(data + size), next_(nullptr), left_(0) {
+	if (size < sizeof(FrameHeader)) return;
+	std::memcpy(&header_, data, sizeof(header_));
+	if (header_.magic != kMagic || header_.version != kVersion || header_.flags != 0) return;
+	if (header_.payloadBytes > size - sizeof(FrameHeader)) return;
+	next_ = data + sizeof(FrameHeader);
+	end_  = next_ + header_.payloadBytes;
+	left_ = header_.records;
+      }
+
+      static bool isFrame(const char* data, size_t size) {
+	uint32_t magic;
+	if (size < sizeof(magic)) return false;
+	std::memcpy(&magic, data, sizeof(magic));
+	return magic == kMagic;
+      }
+
+      bool   valid() const { return next_ != nullptr; }
+      size_t records() const { return valid() ? header_.records : 0; }
+
+      // false at the end of the frame or on a truncated record
+      bool next(View& view) {
+	if (left_ == 0 || size_t(end_ - next_) < sizeof(RecordHeader)) return false;
+	uint32_t bytes;
+	std::memcpy(&bytes, next_, sizeof(bytes));
+	if (bytes < sizeof(RecordHeader) || bytes > size_t(end_ - next_)) return false;
+	view = View(next_);
+	const RecordHeader& r = view.header();
+	if (r.dimension < 1 || r.dimension > 2) return false;
+	// every axis has bins, and a 1D record none along y
+	if (r.nx == 0 || r.nx > kMaxBins || (r.ny == 0) != (r.dimension == 1) || r.ny > kMaxBins) return false;
+	size_t needed = size_t(view.labels_() - next_);
+	if (needed > bytes) return false;
+	if (view.header().flags & kLabels && view.walkLabels_(next_ + bytes, nullptr, nullptr) == nullptr) return false;
+	next_ += bytes;
+	--left_;
+	return true;
+      }
+
+    private:
+      const char* end_;
+      const char* next_;
+      uint32_t    left_;
+      FrameHeader header_;
+    };
+
+    // Builds frames in a buffer kept between publishes, so steady-state
+    // encoding makes no allocation
+    class Writer {
+    public:
+      void begin() {
+	buffer_.clear();
+	records_ = 0;
+	FrameHeader header{kMagic, kVersion, 0, 0, 0, 0};
+	append_(&header, sizeof(header));
+      }
+
+      // false for histograms of more than two dimensions, which are not sent
+      bool add(const std::string& group, const TH1* h) {
+	int dimension = h->GetDimension();
+	if (dimension > 2) return false;
+	const TAxis*   xaxis = h->GetXaxis();
+	const TAxis*   yaxis = h->GetYaxis();
+	const TArrayD* xbins = xaxis->GetXbins();
+	const TArrayD* ybins = yaxis->GetXbins();
+	const char*    name  = h->GetName();   // appended in place: no string per record
+	const char*    title = h->GetTitle();
+	size_t         nameLength  = std::strlen(name);
+	size_t         titleLength = std::strlen(title);
+
+	RecordHeader r;
+	std::memset(&r, 0, sizeof(r));
+	r.dimension   = dimension;
+	r.groupLength = group.size();
+	r.nameLength  = nameLength;
+	r.titleLength = titleLength;
+	r.nx          = h->GetNbinsX();
+	r.ny          = dimension == 2 ? h->GetNbinsY() : 0;
+	r.xmin        = xaxis->GetXmin();
+	r.xmax        = xaxis->GetXmax();
+	r.ymin        = dimension == 2 ? yaxis->GetXmin() : 0;
+	r.ymax        = dimension == 2 ? yaxis->GetXmax() : 0;
+	r.entries     = h->GetEntries();
+	double stats[13] = {0};  // TH1::kNstat
+	h->GetStats(stats);
+	std::memcpy(r.stats, stats, sizeof(r.stats));
+	if (xbins && xbins->GetSize() > 0) r.flags |= kVariableX;
+	if (dimension == 2 && ybins && ybins->GetSize() > 0) r.flags |= kVariableY;
+	if (h->GetSumw2N() > 0) r.flags |= kSumw2;
+	// the DQM summaries (drift, health, integrity, throughput) name their bins
+	bool xlabels = xaxis->GetLabels() != nullptr;
+	bool ylabels = dimension == 2 && yaxis->GetLabels() != nullptr;
+	if (xlabels || ylabels) r.flags |= kLabels;
+
+	// the bin array of TH1F/TH2F and TH1D/TH2D is copied as it is
+	size_t         cells = size_t(r.nx + 2) * (dimension == 2 ? r.ny + 2 : 1);
+	const TArrayF* f     = dynamic_cast<const TArrayF*>(h);
+	const TArrayD* d     = dynamic_cast<const TArrayD*>(h);
+	r.content            = f ? kFloat : kDouble;
+	size_t contentBytes  = cells * (f ? sizeof(float) : sizeof(double));
+
+	size_t start = buffer_.size();
+	append_(&r, sizeof(r));
+	buffer_.append(group).append(name, nameLength).append(title, titleLength);
+	pad_();
+	if (r.flags & kVariableX) append_(xbins->GetArray(), (r.nx + 1) * sizeof(double));
+	if (r.flags & kVariableY) append_(ybins->GetArray(), (r.ny + 1) * sizeof(double));
+	if (f) {
+	  append_(f->GetArray(), contentBytes);
+	} else if (d) {
+	  append_(d->GetArray(), contentBytes);
+	} else {
+	  for (size_t i = 0; i < cells; ++i) {
+	    double v = h->GetBinContent(int(i));
+	    append_(&v, sizeof(v));
+	  }
+	}
+	pad_();
+	if (r.flags & kSumw2) append_(h->GetSumw2()->GetArray(), cells * sizeof(double));
+	if (r.flags & kLabels) {
+	  appendLabels_(xlabels ? xaxis : nullptr, r.nx);
+	  appendLabels_(ylabels ? yaxis : nullptr, r.ny);
+	  pad_();
+	}
+
+	uint32_t bytes = buffer_.size() - start;
+	std::memcpy(&buffer_[start], &bytes, sizeof(bytes));
+	++records_;
+	return true;
+      }
+
+      // the finished frame, valid until the next begin()
+      const std::string& finish() {
+	FrameHeader* header  = reinterpret_cast<FrameHeader*>(&buffer_[0]);
+	header->records      = records_;
+	header->payloadBytes = buffer_.size() - sizeof(FrameHeader);
+	return buffer_;
+      }
+
+    private:
+      void append_(const void* p, size_t n) { buffer_.append(static_cast<const char*>(p), n); }
+      void pad_() { buffer_.append(padded(buffer_.size()) - buffer_.size(), '\0'); }
+      void appendLabels_(const TAxis* axis, uint32_t n) {
+	for (uint32_t i = 1; i <= n; ++i) {
+	  const char* label  = axis ? axis->GetBinLabel(i) : "";
+	  uint16_t    length = std::min<size_t>(std::strlen(label), UINT16_MAX);
+	  append_(&length, sizeof(length));
+	  append_(label, length);
+	}
+      }
+
+      std::string buffer_;
+      uint32_t    records_ = 0;
+    };
+
+    // Detached ROOT histogram with the contents, statistics and labels of `v`; the
+    // caller owns it
+    inline TH1* toTH1(const View& v) {
+      const RecordHeader& r     = v.header();
+      std::string         name  = v.name();
+      std::string         title = v.title();
+      std::vector<double> xedges, yedges;
+      if (v.xEdges()) {
+	xedges.resize(r.nx + 1);
+	std::memcpy(xedges.data(), v.xEdges(), xedges.size() * sizeof(double));
+      }
+      if (v.yEdges()) {
+	yedges.resize(r.ny + 1);
+	std::memcpy(yedges.data(), v.yEdges(), yedges.size() * sizeof(double));
+      }
+
+      bool addDirectory = TH1::AddDirectoryStatus();
+      TH1::AddDirectory(false);
+      TH1* h = nullptr;
+      if (r.dimension == 1) {
+	if (r.content == kFloat) {
+	  h = xedges.empty() ? new TH1F(name.c_str(), title.c_str(), r.nx, r.xmin, r.xmax)
+	                     : new TH1F(name.c_str(), title.c_str(), r.nx, xedges.data());
+	} else {
+	  h = xedges.empty() ? new TH1D(name.c_str(), title.c_str(), r.nx, r.xmin, r.xmax)
+	                     : new TH1D(name.c_str(), title.c_str(), r.nx, xedges.data());
+	}
+      } else if (xedges.empty() && yedges.empty()) {
+	if (r.content == kFloat) {
+	  h = new TH2F(name.c_str(), title.c_str(), r.nx, r.xmin, r.xmax, r.ny, r.ymin, r.ymax);
+	} else {
+	  h = new TH2D(name.c_str(), title.c_str(), r.nx, r.xmin, r.xmax, r.ny, r.ymin, r.ymax);
+	}
+      } else {
+	// either axis may be variable: give both as edges
+	if (xedges.empty()) {
+	  for (uint32_t i = 0; i <= r.nx; ++i) xedges.push_back(r.xmin + (r.xmax - r.xmin) * i / r.nx);
+	}
+	if (yedges.empty()) {
+	  for (uint32_t i = 0; i <= r.ny; ++i) yedges.push_back(r.ymin + (r.ymax - r.ymin) * i / r.ny);
+	}
+	if (r.content == kFloat) {
+	  h = new TH2F(name.c_str(), title.c_str(), r.nx, xedges.data(), r.ny, yedges.data());
+	} else {
+	  h = new TH2D(name.c_str(), title.c_str(), r.nx, xedges.data(), r.ny, yedges.data());
+	}
+      }
+      TH1::AddDirectory(addDirectory);
+
+      if (r.content == kFloat) {
+	std::memcpy(dynamic_cast<TArrayF*>(h)->GetArray(), v.contents(), v.contentBytes());
+      } else {
+	std::memcpy(dynamic_cast<TArrayD*>(h)->GetArray(), v.contents(), v.contentBytes());
+      }
+      if (v.sumw2()) {
+	h->Sumw2();
+	std::memcpy(h->GetSumw2()->GetArray(), v.sumw2(), v.cells() * sizeof(double));
+      }
+      double stats[13] = {0};  // TH1::kNstat
+      std::memcpy(stats, r.stats, sizeof(r.stats));
+      h->PutStats(stats);
+      h->SetEntries(r.entries);
+
+      std::vector<std::string> xlabels, ylabels;
+      if (v.labels(xlabels, ylabels)) {
+	for (size_t i = 0; i < xlabels.size(); ++i) {
+	  if (!xlabels[i].empty()) h->GetXaxis()->SetBinLabel(i + 1, xlabels[i].c_str());
+	}
+	for (size_t i = 0; i < ylabels.size(); ++i) {
+	  if (!ylabels[i].empty()) h->GetYaxis()->SetBinLabel(i + 1, ylabels[i].c_str());
+	}
+      }
+      return h;
+    }
+
+  } // namespace BinaryHisto
+
+} // namespace ots
+
+#endif
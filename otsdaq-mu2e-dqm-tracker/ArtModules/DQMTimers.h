@@ -0,0 +1,145 @@
+// Low-overhead timing for the DQM modules: a tick counter (rdtsc on x86-64,
+// steady_clock elsewhere), scoped timers and log-binned latency histograms
+// that only increment an integer counter per measurement.
+#ifndef _DQMTimers_h_
+#define _DQMTimers_h_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OTSDAQ_DQM_HAVE_RDTSC 1
+#endif
+
+namespace ots {
+
+  class DQMClock {
+  public:
+    static uint64_t ticks() {
+#ifdef OTSDAQ_DQM_HAVE_RDTSC
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	       std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static double nsPerTick() {
+      static const double scale = calibrate();
+      return scale;
+    }
+
+    static uint64_t toNs(uint64_t ticks) { return uint64_t(ticks * nsPerTick()); }
+
+  private:
+    // measure the TSC frequency against steady_clock once, at first use
+    static double calibrate() {
+#ifdef OTSDAQ_DQM_HAVE_RDTSC
+      auto     t0 = std::chrono::steady_clock::now();
+      uint64_t c0 = ticks();
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      uint64_t c1 = ticks();
+      auto     t1 = std::chrono::steady_clock::now();
+      double   ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+      return c1 > c0 ? ns / double(c1 - c0) : 1.;
+#else
+      return 1.;
+#endif
+    }
+  };
+
+  // Counts per log2 octave of nanoseconds, each octave split in kSubBins bins,
+  // from 2^kMinOctave ns (underflow) to 2^kMaxOctave ns (overflow)
+  class LatencyHistogram {
+  public:
+    enum { kMinOctave = 6, kMaxOctave = 31, kSubBits = 2, kSubBins = 1 << kSubBits,
+	   kNBins = (kMaxOctave - kMinOctave) * kSubBins };
+
+    LatencyHistogram() { reset(); }
+
+    static int bin(uint64_t ns) {
+      if (ns < (uint64_t(1) << kMinOctave)) return -1;
+      int octave = 63 - __builtin_clzll(ns);
+      if (octave >= kMaxOctave) return kNBins;
+      int sub = int(ns >> (octave - kSubBits)) & (kSubBins - 1);
+      return (octave - kMinOctave) * kSubBins + sub;
+    }
+
+    // lower edge, in ns, of bin i (i = kNBins gives the upper edge of the last bin)
+    static double lowEdge(int i) {
+      int octave = kMinOctave + i / kSubBins;
+      int sub    = i % kSubBins;
+      return double(uint64_t(1) << octave) * (1. + double(sub) / kSubBins);
+    }
+
+    void record(uint64_t ns) {
+      int b = bin(ns);
+      if (b < 0) ++underflow_;
+      else if (b >= kNBins) ++overflow_;
+      else ++counts_[b];
+      ++entries_;
+      sumNs_ += ns;
+      maxNs_ = std::max(maxNs_, ns);
+    }
+
+    // upper edge of the bin holding the requested fraction of the entries
+    double quantile(double q) const {
+      if (entries_ == 0) return 0.;
+      uint64_t target = uint64_t(q * entries_);
+      uint64_t sum    = underflow_;
+      if (sum > target) return lowEdge(0);
+      for (int i = 0; i < kNBins; ++i) {
+	sum += counts_[i];
+	if (sum > target) return lowEdge(i + 1);
+      }
+      return double(maxNs_);
+    }
+
+    uint64_t count(int i) const { return counts_[i]; }
+    uint64_t underflow() const { return underflow_; }
+    uint64_t overflow() const { return overflow_; }
+    uint64_t entries() const { return entries_; }
+    double   meanNs() const { return entries_ ? double(sumNs_) / entries_ : 0.; }
+    uint64_t maxNs() const { return maxNs_; }
+
+    void reset() {
+      counts_.fill(0);
+      underflow_ = overflow_ = entries_ = sumNs_ = maxNs_ = 0;
+    }
+
+  private:
+    std::array<uint64_t, kNBins> counts_;
+    uint64_t                     underflow_;
+    uint64_t                     overflow_;
+    uint64_t                     entries_;
+    uint64_t                     sumNs_;
+    uint64_t                     maxNs_;
+  };
+
+  // Records the lifetime of the object into a LatencyHistogram, or adds the
+  // elapsed ticks to an accumulator when several intervals make up one measurement
+  class ScopedTimer {
+  public:
+    explicit ScopedTimer(LatencyHistogram* hist) : hist_(hist), acc_(nullptr), start_(DQMClock::ticks()) {}
+    explicit ScopedTimer(uint64_t* acc) : hist_(nullptr), acc_(acc), start_(DQMClock::ticks()) {}
+    ~ScopedTimer() {
+      uint64_t elapsed = DQMClock::ticks() - start_;
+      if (hist_) hist_->record(DQMClock::toNs(elapsed));
+      if (acc_) *acc_ += elapsed;
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    LatencyHistogram* hist_;
+    uint64_t*         acc_;
+    uint64_t          start_;
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,136 @@
+// Per DTC/ROC-link counters of the tracker data blocks seen by trackerDQM,
+// together with the event size and decode throughput. All counters are plain
+// integers in a flat array indexed by (DTC ID, link), cleared after each publish.
+#ifndef _DataIntegrityMonitor_h_
+#define _DataIntegrityMonitor_h_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace ots {
+
+  class DataIntegrityMonitor {
+  public:
+    enum { kMaxDTCs = 256, kMaxLinks = 8, kPacketBytes = 16 };
+
+    struct LinkCounters {
+      uint64_t blocks;
+      uint64_t packets;
+      uint64_t bytes;
+      uint64_t emptyBlocks;
+      uint64_t malformedBlocks;
+    };
+
+    enum BlockStatus { kGood, kEmpty, kMalformed };
+
+    DataIntegrityMonitor() : links_(kMaxDTCs * kMaxLinks) { reset(); }
+
+    static int linkIndex(int dtc, int link) { return dtc * kMaxLinks + link; }
+    static int dtc(int index) { return index / kMaxLinks; }
+    static int link(int index) { return index % kMaxLinks; }
+
+    void beginEvent() { eventBytes_ = 0; }
+
+    void endEvent() {
+      bytes_ += eventBytes_;
+      ++events_;
+    }
+
+    void addFragment(size_t bytes) { eventBytes_ += bytes; }
+
+    // Time spent walking the data blocks of the event, without the histogram
+    // fills (the decode ticks of fill_tracker_fragment)
+    void addDecodeNs(uint64_t ns) { decodeNs_ += ns; }
+
+    // A block whose header could not be retrieved: the link is unknown
+    void unreadableBlock() { ++unreadableBlocks_; }
+
+    // Classify one data block from its DTC header. A block is malformed if the
+    // byte count cannot hold the header plus the announced data packets, or if
+    // the decoder returned no hits for a non-empty block.
+    BlockStatus block(int dtcID, int linkID, uint32_t packetCount, uint32_t byteCount, bool decoded) {
+      LinkCounters& c = links_[linkIndex(dtcID & (kMaxDTCs - 1), linkID & (kMaxLinks - 1))];
+      ++c.blocks;
+      c.packets += packetCount;
+      c.bytes   += byteCount;
+      if (byteCount < kPacketBytes * (packetCount + 1) || (packetCount > 0 && !decoded)) {
+	++c.malformedBlocks;
+	return kMalformed;
+      }
+      if (packetCount == 0) {
+	++c.emptyBlocks;
+	return kEmpty;
+      }
+      return kGood;
+    }
+
+    void addHits(size_t n) { hits_ += n; }
+
+    // A hit whose straw id is outside the tracker; it is not filled
+    void malformedHit() { ++malformedHits_; }
+
+    // Add the counters of a monitor filled by another thread and clear them
+    // there; its current event and counting window are left alone
+    void merge(DataIntegrityMonitor& from) {
+      for (size_t i = 0; i < links_.size(); ++i) {
+	LinkCounters& c = links_[i];
+	LinkCounters& f = from.links_[i];
+	c.blocks          += f.blocks;
+	c.packets         += f.packets;
+	c.bytes           += f.bytes;
+	c.emptyBlocks     += f.emptyBlocks;
+	c.malformedBlocks += f.malformedBlocks;
+	f = LinkCounters{0, 0, 0, 0, 0};
+      }
+      events_           += from.events_;
+      bytes_            += from.bytes_;
+      hits_             += from.hits_;
+      unreadableBlocks_ += from.unreadableBlocks_;
+      malformedHits_    += from.malformedHits_;
+      decodeNs_         += from.decodeNs_;
+      from.events_ = from.bytes_ = from.hits_ = from.unreadableBlocks_ = from.malformedHits_ = 0;
+      from.decodeNs_ = 0;
+    }
+
+    const std::vector<LinkCounters>& links() const { return links_; }
+    static bool active(const LinkCounters& c) { return c.blocks > 0; }
+
+    uint64_t events() const { return events_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t hits() const { return hits_; }
+    uint64_t unreadableBlocks() const { return unreadableBlocks_; }
+    uint64_t malformedHits() const { return malformedHits_; }
+    uint64_t lastEventBytes() const { return eventBytes_; }
+
+    // time spent decoding, as reported by addDecodeNs
+    double decodeSeconds() const { return decodeNs_ * 1e-9; }
+    // wall-clock time since the last reset
+    double windowSeconds() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - windowStart_).count();
+    }
+
+    void reset() {
+      std::fill(links_.begin(), links_.end(), LinkCounters{0, 0, 0, 0, 0});
+      events_ = bytes_ = hits_ = unreadableBlocks_ = malformedHits_ = 0;
+      decodeNs_ = 0;
+      eventBytes_ = 0;
+      windowStart_ = std::chrono::steady_clock::now();
+    }
+
+  private:
+    std::vector<LinkCounters>             links_;
+    uint64_t                              events_;
+    uint64_t                              bytes_;
+    uint64_t                              hits_;
+    uint64_t                              unreadableBlocks_;
+    uint64_t                              malformedHits_;
+    uint64_t                              eventBytes_;
+    int64_t                               decodeNs_;
+    std::chrono::steady_clock::time_point windowStart_;
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,100 @@
+// Bounded lock-free queue handing events from the art thread to the DQM
+// workers. One sequence number per cell (D. Vyukov's bounded queue) lets any
+// number of consumers pop while the producer pushes, with one CAS per operation
+// and no allocation after construction. Both calls fail instead of waiting; the
+// caller decides whether to retry or give up.
+#ifndef _FragmentRing_h_
+#define _FragmentRing_h_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace ots {
+
+  template <class T>
+  class FragmentRing {
+  public:
+    // capacity is rounded up to a power of two
+    explicit FragmentRing(size_t capacity) {
+      size_t n = 2;
+      while (n < capacity) n <<= 1;
+      mask_  = n - 1;
+      cells_.reset(new Cell[n]);
+      for (size_t i = 0; i < n; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+      head_.store(0, std::memory_order_relaxed);
+      tail_.store(0, std::memory_order_relaxed);
+    }
+
+    FragmentRing(const FragmentRing&) = delete;
+    FragmentRing& operator=(const FragmentRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // false if the ring is full; `value` is left untouched then
+    bool push(T& value) {
+      Cell*  cell;
+      size_t pos = tail_.load(std::memory_order_relaxed);
+      for (;;) {
+	cell        = &cells_[pos & mask_];
+	size_t   seq = cell->sequence.load(std::memory_order_acquire);
+	intptr_t dif = intptr_t(seq) - intptr_t(pos);
+	if (dif == 0) {
+	  if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+	} else if (dif < 0) {
+	  return false;
+	} else {
+	  pos = tail_.load(std::memory_order_relaxed);
+	}
+      }
+      std::swap(cell->value, value);
+      cell->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    // false if the ring is empty. The popped cell keeps what `value` held
+    // before, so buffers circulate between producer and consumers.
+    bool pop(T& value) {
+      Cell*  cell;
+      size_t pos = head_.load(std::memory_order_relaxed);
+      for (;;) {
+	cell        = &cells_[pos & mask_];
+	size_t   seq = cell->sequence.load(std::memory_order_acquire);
+	intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+	if (dif == 0) {
+	  if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+	} else if (dif < 0) {
+	  return false;
+	} else {
+	  pos = head_.load(std::memory_order_relaxed);
+	}
+      }
+      std::swap(cell->value, value);
+      cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+      return true;
+    }
+
+    // approximate, for monitoring
+    size_t size() const {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      size_t head = head_.load(std::memory_order_relaxed);
+      return tail > head ? tail - head : 0;
+    }
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      T                   value;
+    };
+
+    std::unique_ptr<Cell[]>          cells_;
+    size_t                           mask_;
+    alignas(64) std::atomic<size_t>  head_;
+    alignas(64) std::atomic<size_t>  tail_;
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,243 @@
+// Optional compression of the DQM packets (BinaryHisto frames, TBufferFile
+// messages) before they go on the network. A compressed packet is a Header
+// followed by the codec output; a packet without the header is sent as it was,
+// so receivers tell the two apart by the magic number and old receivers keep
+// working with compression off. LZ4 and Zstd are used when the build finds
+// them (OTSDAQ_DQM_HAVE_LZ4, OTSDAQ_DQM_HAVE_ZSTD); without them every packet
+// goes out uncompressed.
+//
+// "auto" picks by packet size: below minBytes nothing is worth the header and
+// the CPU, up to zstdBytes LZ4 keeps the publish latency low, and larger frames
+// (the per-straw pedestal sets, mostly zeros and small counts) go through Zstd
+// at the configured level. Packets that would not shrink are sent uncompressed.
+#ifndef _FrameCompressor_h_
+#define _FrameCompressor_h_
+
+#ifdef OTSDAQ_DQM_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace ots {
+
+  class FrameCompressor {
+  public:
+    enum Codec : uint8_t { kNone = 0, kLZ4 = 1, kZstd = 2, kNCodecs };
+
+    struct Header {
+      uint32_t magic;
+      uint8_t  codec;
+      uint8_t  reserved[3];
+      uint64_t rawBytes;  // size of the packet before compression
+    };
+    static const uint32_t kMagic = 0x5a4d5144;  // "DQMZ" in a little-endian dump
+    // largest packet compressed or restored: the LZ4 API counts bytes in int
+    static const size_t kMaxRawBytes = INT_MAX;
+
+    struct Packet {
+      const char* data;
+      size_t      size;
+    };
+
+    struct Stats {
+      uint64_t packets  = 0;
+      uint64_t inBytes  = 0;
+      uint64_t outBytes = 0;
+      uint64_t ns       = 0;  // time spent compressing
+      double   ratio() const { return outBytes > 0 ? double(inBytes) / outBytes : 1.; }
+    };
+
+    static const char* name(Codec codec) {
+      static const char* names[kNCodecs] = {"none", "lz4", "zstd"};
+      return codec < kNCodecs ? names[codec] : "unknown";
+    }
+
+    static bool available(Codec codec) {
+      switch (codec) {
+      case kNone: return true;
+#ifdef OTSDAQ_DQM_HAVE_LZ4
+      case kLZ4: return true;
+#endif
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+      case kZstd: return true;
+#endif
+      default: return false;
+      }
+    }
+
+    // codec: none, lz4, zstd or auto; level: Zstd compression level
+    FrameCompressor(const std::string& codec, int level, size_t minBytes, size_t zstdBytes)
+      : auto_(codec == "auto"), ok_(auto_), codec_(kNone), level_(level), minBytes_(minBytes),
+	zstdBytes_(zstdBytes), zstd_(nullptr) {
+      for (int c = 0; c < kNCodecs; ++c) {
+	if (codec == name(Codec(c))) {
+	  codec_ = Codec(c);
+	  ok_    = true;
+	}
+      }
+      if (!available(codec_)) {
+	codec_ = kNone;
+	ok_    = false;
+      }
+      if (auto_ && !available(kLZ4) && !available(kZstd)) {
+	auto_ = false;
+	ok_   = false;
+      }
+    }
+    ~FrameCompressor() {
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+      ZSTD_freeCCtx(zstd_);
+#endif
+    }
+    FrameCompressor(const FrameCompressor&) = delete;
+    FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+    // false if the configured codec is unknown or not built in: all packets then go out uncompressed
+    bool ok() const { return ok_; }
+    bool enabled() const { return auto_ || codec_ != kNone; }
+
+    Codec choose(size_t size) const {
+      if (size > kMaxRawBytes) return kNone;
+      if (!auto_) return size < minBytes_ ? kNone : codec_;
+      if (size < minBytes_) return kNone;
+      if (size < zstdBytes_) return available(kLZ4) ? kLZ4 : kZstd;
+      return available(kZstd) ? kZstd : kLZ4;
+    }
+
+    // What to send for `data`: either `data` itself or the compressed packet,
+    // which stays valid until the next call
+    Packet compress(const char* data, size_t size) {
+      Codec codec = choose(size);
+      Stats& stats = stats_[codec];
+      ++stats.packets;
+      stats.inBytes += size;
+      if (codec == kNone) {
+	stats.outBytes += size;
+	return Packet{data, size};
+      }
+
+      auto   start = std::chrono::steady_clock::now();
+      size_t bytes = 0;
+      buffer_.resize(sizeof(Header) + bound_(codec, size));
+      [[maybe_unused]] char* out = &buffer_[sizeof(Header)];
+#ifdef OTSDAQ_DQM_HAVE_LZ4
+      if (codec == kLZ4) {
+	int n = LZ4_compress_default(data, out, int(size), int(buffer_.size() - sizeof(Header)));
+	bytes = n > 0 ? size_t(n) : 0;
+      }
+#endif
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+      if (codec == kZstd) {
+	if (zstd_ == nullptr) zstd_ = ZSTD_createCCtx();
+	size_t n = ZSTD_compressCCtx(zstd_, out, buffer_.size() - sizeof(Header), data, size, level_);
+	bytes = ZSTD_isError(n) ? 0 : n;
+      }
+#endif
+      stats.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+		    std::chrono::steady_clock::now() - start).count();
+
+      if (bytes == 0 || sizeof(Header) + bytes >= size) {
+	stats.outBytes += size;
+	return Packet{data, size};
+      }
+      Header header{kMagic, codec, {0, 0, 0}, size};
+      std::memcpy(&buffer_[0], &header, sizeof(header));
+      stats.outBytes += sizeof(Header) + bytes;
+      return Packet{buffer_.data(), sizeof(Header) + bytes};
+    }
+
+    // same for senders taking strings: `frame` itself or the compressed packet
+    const std::string& compress(const std::string& frame) {
+      Packet packet = compress(frame.data(), frame.size());
+      if (packet.data == frame.data()) return frame;
+      buffer_.resize(packet.size);
+      return buffer_;
+    }
+
+    static bool isCompressed(const char* data, size_t size) {
+      uint32_t magic;
+      if (size < sizeof(Header)) return false;
+      std::memcpy(&magic, data, sizeof(magic));
+      return magic == kMagic;
+    }
+
+    // Original packet of a compressed one; false if it is corrupt, claims more
+    // than maxBytes or uses a codec this build does not have. The size comes
+    // from the network and is checked before anything is allocated
+    static bool decompress(const char* data, size_t size, std::string& out, size_t maxBytes = kMaxRawBytes) {
+      Header header;
+      if (!isCompressed(data, size)) return false;
+      std::memcpy(&header, data, sizeof(header));
+      if (header.rawBytes > maxBytes || header.rawBytes > kMaxRawBytes) return false;
+      [[maybe_unused]] const char* in = data + sizeof(Header);
+      [[maybe_unused]] size_t bytes = size - sizeof(Header);
+      out.resize(header.rawBytes);
+      switch (header.codec) {
+#ifdef OTSDAQ_DQM_HAVE_LZ4
+      case kLZ4:
+	return LZ4_decompress_safe(in, &out[0], int(bytes), int(out.size())) == int(out.size());
+#endif
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+      case kZstd:
+	return ZSTD_decompress(&out[0], out.size(), in, bytes) == out.size();
+#endif
+      default:
+	return false;
+      }
+    }
+
+    const Stats& stats(Codec codec) const { return stats_[codec]; }
+
+    // one line per codec used: packets, bytes in and out, ratio, throughput
+    std::string summary() const {
+      std::string out;
+      for (int c = 0; c < kNCodecs; ++c) {
+	const Stats& s = stats_[c];
+	if (s.packets == 0) continue;
+	char line[200];
+	std::snprintf(line, sizeof(line), "%s: %llu packets, %.2f MB -> %.2f MB (ratio %.2f), %.0f MB/s\n",
+		      name(Codec(c)), (unsigned long long)s.packets, s.inBytes * 1e-6, s.outBytes * 1e-6,
+		      s.ratio(), s.ns > 0 ? s.inBytes * 1e3 / s.ns : 0.);
+	out += line;
+      }
+      return out;
+    }
+
+  private:
+    static size_t bound_([[maybe_unused]] Codec codec, size_t size) {
+#ifdef OTSDAQ_DQM_HAVE_LZ4
+      if (codec == kLZ4) return LZ4_compressBound(int(size));
+#endif
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+      if (codec == kZstd) return ZSTD_compressBound(size);
+#endif
+      return size;
+    }
+
+    bool        auto_;
+    bool        ok_;
+    Codec       codec_;
+    int         level_;
+    size_t      minBytes_;
+    size_t      zstdBytes_;
+    std::string buffer_;
+    Stats       stats_[kNCodecs];
+#ifdef OTSDAQ_DQM_HAVE_ZSTD
+    ZSTD_CCtx*  zstd_;
+#else
+    void*       zstd_;
+#endif
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,99 @@
+// Running totals of DQM histograms that the publish loop keeps emptying. Every
+// histogram laid out gets a slot in one flat block of bins, sumw2 and
+// statistics, allocated once at booking; what a publish is about to clear is
+// added to its slot, so at the end of a subrun the arena holds the whole
+// subrun. Clearing it for the next one is a memset of the block.
+#ifndef _HistoArena_h_
+#define _HistoArena_h_
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQMHistoContainer.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/BinMerge.hh"
+#include <TH1F.h>
+#include <cstring>
+#include <vector>
+
+namespace ots {
+
+  class HistoArena {
+  public:
+    enum { kStats = 5 };  // entries, sumw, sumw2, sumwx, sumwx2
+
+    // One slot per histogram of the containers, in order; the histograms must
+    // be booked and keep their binning
+    void layout(const std::vector<const TrackerDQMHistoContainer*>& containers) {
+      first_.clear();
+      offsets_.assign(1, 0);
+      for (const TrackerDQMHistoContainer* c : containers) {
+	first_.push_back({c, offsets_.size() - 1});
+	for (const auto& h : c->histograms) offsets_.push_back(offsets_.back() + h._Hist->GetNcells());
+      }
+      cells_.assign(offsets_.back(), 0.f);
+      sumw2_.assign(offsets_.back(), 0.);
+      stats_.assign(kStats * slots(), 0.);
+      weighted_.assign(slots(), 0);
+    }
+
+    size_t slots() const { return offsets_.size() - 1; }
+    size_t bytes() const {
+      return cells_.size() * sizeof(float) + (sumw2_.size() + stats_.size()) * sizeof(double) + weighted_.size();
+    }
+
+    // slot of histograms[0] of the container, -1 when it is not laid out
+    long find(const TrackerDQMHistoContainer* c) const {
+      for (const auto& f : first_) {
+	if (f.first == c) return long(f.second);
+      }
+      return -1;
+    }
+
+    void add(size_t slot, const TH1F* hist) {
+      if (hist->GetEntries() == 0) return;
+      size_t n = offsets_[slot + 1] - offsets_[slot];
+      detail::add_bins(cells_.data() + offsets_[slot], hist->fArray, n);
+      double* sumw2 = sumw2_.data() + offsets_[slot];
+      if (hist->GetSumw2N() > 0) {
+	detail::add_bins(sumw2, hist->GetSumw2()->fArray, n);
+	weighted_[slot] = 1;
+      } else {
+	for (size_t i = 0; i < n; ++i) sumw2[i] += hist->fArray[i];  // unit weights: sumw2 is the content
+      }
+      double stats[4];
+      hist->GetStats(stats);
+      double* s = &stats_[kStats * slot];
+      s[0] += hist->GetEntries();
+      for (int k = 0; k < 4; ++k) s[k + 1] += stats[k];
+    }
+
+    // Overwrite a histogram of the same binning with the totals of a slot
+    void copyTo(size_t slot, TH1F* hist) const {
+      size_t n = offsets_[slot + 1] - offsets_[slot];
+      std::memcpy(hist->fArray, cells_.data() + offsets_[slot], n * sizeof(float));
+      if (weighted_[slot] || hist->GetSumw2N() > 0) {
+	if (hist->GetSumw2N() == 0) hist->Sumw2();
+	std::memcpy(hist->GetSumw2()->fArray, sumw2_.data() + offsets_[slot], n * sizeof(double));
+      }
+      const double* s = &stats_[kStats * slot];
+      double stats[4] = {s[1], s[2], s[3], s[4]};
+      hist->PutStats(stats);
+      hist->SetEntries(s[0]);
+    }
+
+    void clear() {
+      std::memset(cells_.data(), 0, cells_.size() * sizeof(float));
+      std::memset(sumw2_.data(), 0, sumw2_.size() * sizeof(double));
+      std::memset(stats_.data(), 0, stats_.size() * sizeof(double));
+      std::memset(weighted_.data(), 0, weighted_.size());
+    }
+
+  private:
+    std::vector<std::pair<const TrackerDQMHistoContainer*, size_t>> first_;
+    std::vector<size_t>  offsets_;   // first cell of each slot, then the total
+    std::vector<float>   cells_;
+    std::vector<double>  sumw2_;
+    std::vector<double>  stats_;
+    std::vector<char>    weighted_;  // a histogram with sumw2 went into the slot
+  };
+
+} // namespace ots
+
+#endif
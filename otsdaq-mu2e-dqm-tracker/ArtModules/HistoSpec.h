@@ -0,0 +1,183 @@
+// Binning of the DQM histograms. The standard layouts are constexpr defaults;
+// a HistoSpecTable starts from them and can be overridden per job, from FHiCL
+// (histoBinning: { pedestal: [400, 0, 500] nStrawDigiVsLum: [500, 1e6, 4e8, 1000, 0, 20000] })
+// or from an otsdaq configuration table (one row per histogram, columns
+// NBinsX, XMin, XMax and for 2D NBinsY, YMin, YMax), so memory and resolution
+// can be tuned per run without a rebuild.
+//
+// UniformAxis is the bin lookup of a uniformly binned axis, done the way
+// TAxis::FindFixBin does it so the fill kernels built on it put every value in
+// the same bin as TH1::Fill. IntegerAxis tabulates it for integer inputs.
+#ifndef _HistoSpec_h_
+#define _HistoSpec_h_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace ots {
+
+  struct UniformAxis {
+    int    n   = 0;  // 0: not uniformly binned, fill through TH1::Fill
+    double min = 0.;
+    double max = 0.;
+
+    constexpr UniformAxis() = default;
+    constexpr UniformAxis(int nBins, double lo, double hi) : n(nBins), min(lo), max(hi) {}
+
+    constexpr bool uniform() const { return n > 0; }
+
+    // 0 underflow, n + 1 overflow
+    constexpr int bin(double x) const {
+      return x < min ? 0 : !(x < max) ? n + 1 : 1 + int(n * (x - min) / (max - min));
+    }
+  };
+
+  // Bin of every integer between the axis limits, taken from UniformAxis::bin
+  // once at booking, so integer fills are a subtraction and a table load and
+  // still land in the bin TH1::Fill would pick
+  class IntegerAxis {
+  public:
+    enum { kMaxValues = 1 << 16 };  // larger ranges keep the floating-point lookup
+
+    static bool suitable(const UniformAxis& a) {
+      return a.uniform() && a.n < 65535 && std::ceil(a.min) >= -2e9 && std::floor(a.max) <= 2e9 &&
+	     std::floor(a.max) - std::ceil(a.min) < kMaxValues;
+    }
+
+    explicit IntegerAxis(const UniformAxis& a)
+      : axis_(a), low_(int(std::ceil(a.min))), high_(int(std::floor(a.max))), bins_(high_ - low_ + 1) {
+      for (int v = low_; v <= high_; ++v) bins_[v - low_] = uint16_t(a.bin(v));
+    }
+
+    const UniformAxis& axis() const { return axis_; }
+
+    // below low_ is below min, above high_ is above max
+    int bin(int v) const { return v < low_ ? 0 : v > high_ ? axis_.n + 1 : bins_[v - low_]; }
+
+  private:
+    UniformAxis           axis_;
+    int                   low_;
+    int                   high_;
+    std::vector<uint16_t> bins_;
+  };
+
+  struct HistoSpec {
+    const char* name;
+    UniformAxis x;
+    UniformAxis y;  // y.n == 0 for 1D histograms
+
+    constexpr bool is2D() const { return y.n > 0; }
+    // cells including under- and overflows, what a TH1F/TH2F allocates
+    constexpr long cells() const { return (x.n + 2L) * (is2D() ? y.n + 2L : 1L); }
+  };
+
+  namespace HistoSpecs {
+    // TrackerDQM
+    constexpr HistoSpec kPanelOccupancy  {"panelOccupancy",  {220, 0., 220.}, {}};
+    constexpr HistoSpec kPlaneOccupancy  {"planeOccupancy",  {40, 0., 40.},   {}};
+    constexpr HistoSpec kPedestal        {"pedestal",        {200, 0., 500.}, {}};
+    constexpr HistoSpec kPanel           {"panel",           {100, 0., 100.}, {}};
+    constexpr HistoSpec kDeltaT          {"deltaT",          {200, -1000., 1000.}, {}};
+    constexpr HistoSpec kPanelDeltaT     {"panelDeltaT",     {200, -1000., 1000.}, {}};
+    constexpr HistoSpec kTot             {"tot",             {16, 0., 16.},   {}};
+    constexpr HistoSpec kPanelTot        {"panelTot",        {16, 0., 16.},   {}};
+    constexpr HistoSpec kHitMultiplicity {"hitMultiplicity", {200, 0., 2000.}, {}};
+    constexpr HistoSpec kEventKBytes     {"eventKBytes",     {100, 0., 500.}, {}};
+    // Occupancy, BeamMonitor
+    constexpr HistoSpec kInstLum         {"instLum",         {1000, 1e6, 4e8}, {}};
+    constexpr HistoSpec kNStrawDigiVsLum {"nStrawDigiVsLum", {1000, 1e6, 4e8}, {5000, 0., 20000.}};
+    constexpr HistoSpec kNCaloDigiVsLum  {"nCaloDigiVsLum",  {1000, 1e6, 4e8}, {5000, 0., 20000.}};
+
+    constexpr HistoSpec kDefaults[] = {kPanelOccupancy, kPlaneOccupancy, kPedestal, kPanel, kDeltaT,
+				       kPanelDeltaT, kTot, kPanelTot, kHitMultiplicity, kEventKBytes,
+				       kInstLum, kNStrawDigiVsLum, kNCaloDigiVsLum};
+
+    static_assert(kPedestal.x.bin(-1.) == 0 && kPedestal.x.bin(0.) == 1 && kPedestal.x.bin(250.) == 101 &&
+		  kPedestal.x.bin(500.) == 201, "UniformAxis must number bins as TAxis");
+    static_assert(kNStrawDigiVsLum.cells() == 1002L * 5002L, "2D cells include the overflows");
+  } // namespace HistoSpecs
+
+  class HistoSpecTable {
+  public:
+    HistoSpecTable() : specs_(std::begin(HistoSpecs::kDefaults), std::end(HistoSpecs::kDefaults)) {}
+
+    // the default binning of `spec` unless the table overrides it
+    const HistoSpec& operator[](const HistoSpec& spec) const {
+      const HistoSpec* s = find_(spec.name);
+      return s ? *s : spec;
+    }
+
+    // values: nx, xmin, xmax [, ny, ymin, ymax]; the dimension cannot change.
+    // Returns an error message, empty on success.
+    std::string set(const std::string& name, const std::vector<double>& values) {
+      HistoSpec* spec = find_(name.c_str());
+      if (spec == nullptr) return "unknown histogram " + name;
+      size_t expected = spec->is2D() ? 6 : 3;
+      if (values.size() != expected) {
+	return name + " takes " + std::to_string(expected) + " values (nBins, min, max" +
+	       (spec->is2D() ? ", nBinsY, minY, maxY)" : ")");
+      }
+      UniformAxis x(static_cast<int>(values[0]), values[1], values[2]);
+      UniformAxis y = spec->is2D() ? UniformAxis(static_cast<int>(values[3]), values[4], values[5]) : UniformAxis();
+      if (!valid_(x) || (spec->is2D() && !valid_(y))) return name + ": need nBins > 0 and max > min";
+      spec->x = x;
+      spec->y = y;
+      return "";
+    }
+
+    // From a FHiCL table name: [values]; returns the error messages
+    template <class ParameterSet>
+    std::vector<std::string> load(const ParameterSet& pset) {
+      std::vector<std::string> errors;
+      for (const std::string& name : pset.get_names()) {
+	std::string error = set(name, pset.template get<std::vector<double>>(name));
+	if (!error.empty()) errors.push_back(error);
+      }
+      return errors;
+    }
+
+    // From an otsdaq ConfigurationTree table: the row UID is the histogram name
+    template <class ConfigurationTree>
+    std::vector<std::string> loadTree(const ConfigurationTree& table) {
+      std::vector<std::string> errors;
+      for (const auto& row : table.getChildren()) {
+	std::vector<double> values = {double(row.second.getNode("NBinsX").template getValue<int>()),
+				      row.second.getNode("XMin").template getValue<double>(),
+				      row.second.getNode("XMax").template getValue<double>()};
+	const HistoSpec* spec = find_(row.first.c_str());
+	if (spec && spec->is2D()) {
+	  values.push_back(row.second.getNode("NBinsY").template getValue<int>());
+	  values.push_back(row.second.getNode("YMin").template getValue<double>());
+	  values.push_back(row.second.getNode("YMax").template getValue<double>());
+	}
+	std::string error = set(row.first, values);
+	if (!error.empty()) errors.push_back(error);
+      }
+      return errors;
+    }
+
+    const std::vector<HistoSpec>& specs() const { return specs_; }
+
+  private:
+    static bool valid_(const UniformAxis& a) { return a.n > 0 && a.max > a.min; }
+
+    HistoSpec* find_(const char* name) {
+      for (auto& s : specs_) {
+	if (std::strcmp(s.name, name) == 0) return &s;
+      }
+      return nullptr;
+    }
+    const HistoSpec* find_(const char* name) const {
+      return const_cast<HistoSpecTable*>(this)->find_(name);
+    }
+
+    std::vector<HistoSpec> specs_;  // names point to the static defaults
+  };
+
+} // namespace ots
+
+#endif
@@ -4,6 +4,7 @@
 #include "art/Framework/Services/Registry/ServiceHandle.h"
 #include "art_root_io/TFileDirectory.h"
 #include "art_root_io/TFileService.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/HistoSpec.h"
 #include "otsdaq/NetworkUtilities/TCPPublishServer.h"
 #include <TH1F.h>
 #include <TH2F.h>
@@ -36,38 +37,46 @@ public:
   occupancyHist_ Hist;
 
   void BookHistos(art::ServiceHandle<art::TFileService> Tfs, size_t _nTrackTrig,
-                  size_t _nCaloTrig) {
+                  size_t _nCaloTrig,
+                  const HistoSpecTable &specs = HistoSpecTable()) {
+    const HistoSpec &lum = specs[HistoSpecs::kInstLum];
+    const HistoSpec &nsd = specs[HistoSpecs::kNStrawDigiVsLum];
+    const HistoSpec &ncd = specs[HistoSpecs::kNCaloDigiVsLum];
 
     for (unsigned int i = 0; i < _nTrackTrig; ++i) {
       art::TFileDirectory occInfoDir = Tfs->mkdir(Form("occInfoTrk_%i", i));
       this->Hist._hOccInfo[i][0] = occInfoDir.make<TH1F>(
           Form("hInstLum_%i", i),
-          "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+          "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+          lum.x.max);
 
       this->Hist._h2DOccInfo[i][0] = occInfoDir.make<TH2F>(
           Form("hNSDVsLum_%i", i),
-          "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6, 4e8,
-          5000, 0., 20000.);
+          "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n, nsd.x.min,
+          nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
       this->Hist._h2DOccInfo[i][1] =
           occInfoDir.make<TH2F>(Form("hNCDVsLum_%i", i),
                                 "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi",
-                                1000, 1e6, 4e8, 5000, 0., 20000.);
+                                ncd.x.n, ncd.x.min, ncd.x.max, ncd.y.n,
+                                ncd.y.min, ncd.y.max);
     }
 
     for (unsigned int i = _nTrackTrig; i < _nTrackTrig * 2; ++i) {
       art::TFileDirectory occInfoDir = Tfs->mkdir(Form("occInfoHel_%i", i));
       this->Hist._hOccInfo[i][0] = occInfoDir.make<TH1F>(
           Form("hInstLum_%i", i),
-          "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+          "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+          lum.x.max);
 
       this->Hist._h2DOccInfo[i][0] = occInfoDir.make<TH2F>(
           Form("hNSDVsLum_%i", i),
-          "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6, 4e8,
-          5000, 0., 20000.);
+          "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n, nsd.x.min,
+          nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
       this->Hist._h2DOccInfo[i][1] =
           occInfoDir.make<TH2F>(Form("hNCDVsLum_%i", i),
                                 "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi",
-                                1000, 1e6, 4e8, 5000, 0., 20000.);
+                                ncd.x.n, ncd.x.min, ncd.x.max, ncd.y.n,
+                                ncd.y.min, ncd.y.max);
     }
 
     for (unsigned int i = _nTrackTrig * 2; i < _nTrackTrig * 2 + _nCaloTrig;
@@ -76,67 +85,78 @@ public:
           Tfs->mkdir(Form("occInfoCaloTrig_%i", i));
       this->Hist._hOccInfo[i][0] = occInfoDir.make<TH1F>(
           Form("hInstLum_%i", i),
-          "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+          "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+          lum.x.max);
 
       this->Hist._h2DOccInfo[i][0] = occInfoDir.make<TH2F>(
           Form("hNSDVsLum_%i", i),
-          "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6, 4e8,
-          5000, 0., 20000.);
+          "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n, nsd.x.min,
+          nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
       this->Hist._h2DOccInfo[i][1] =
           occInfoDir.make<TH2F>(Form("hNCDVsLum_%i", i),
                                 "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi",
-                                1000, 1e6, 4e8, 5000, 0., 20000.);
+                                ncd.x.n, ncd.x.min, ncd.x.max, ncd.y.n,
+                                ncd.y.min, ncd.y.max);
     }
 
     unsigned int index_last = _nTrackTrig + _nCaloTrig;
     art::TFileDirectory occInfoDir = Tfs->mkdir("occInfoGeneral");
     this->Hist._hOccInfo[index_last][0] = occInfoDir.make<TH1F>(
         Form("hInstLum_%i", index_last),
-        "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+        "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+        lum.x.max);
 
     this->Hist._h2DOccInfo[index_last][0] =
         occInfoDir.make<TH2F>(Form("hNSDVsLum_%i", index_last),
                               "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi",
-                              1000, 1e6, 4e8, 5000, 0., 20000.);
+                              nsd.x.n, nsd.x.min, nsd.x.max, nsd.y.n, nsd.y.min,
+                              nsd.y.max);
     this->Hist._h2DOccInfo[index_last][1] =
         occInfoDir.make<TH2F>(Form("hNCDVsLum_%i", index_last),
                               "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi",
-                              1000, 1e6, 4e8, 5000, 0., 20000.);
+                              ncd.x.n, ncd.x.min, ncd.x.max, ncd.y.n, ncd.y.min,
+                              ncd.y.max);
   }
 
   void BookHistos(TDirectory *occInfoDir, size_t _nTrackTrig,
-                  size_t _nCaloTrig) {
+                  size_t _nCaloTrig,
+                  const HistoSpecTable &specs = HistoSpecTable()) {
+    const HistoSpec &lum = specs[HistoSpecs::kInstLum];
+    const HistoSpec &nsd = specs[HistoSpecs::kNStrawDigiVsLum];
+    const HistoSpec &ncd = specs[HistoSpecs::kNCaloDigiVsLum];
 
     for (unsigned int i = 0; i < _nTrackTrig; ++i) {
       occInfoDir->mkdir(Form("occInfoTrk_%i", i));
       this->Hist._hOccInfo[i][0] = new TH1F(
           Form("hInstLum_%i", i),
-          "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+          "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+          lum.x.max);
 
       this->Hist._h2DOccInfo[i][0] =
           new TH2F(Form("hNSDVsLum_%i", i),
-                   "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6,
-                   4e8, 5000, 0., 20000.);
+                   "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n,
+                   nsd.x.min, nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
       this->Hist._h2DOccInfo[i][1] =
           new TH2F(Form("hNCDVsLum_%i", i),
-                   "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", 1000, 1e6,
-                   4e8, 5000, 0., 20000.);
+                   "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", ncd.x.n,
+                   ncd.x.min, ncd.x.max, ncd.y.n, ncd.y.min, ncd.y.max);
     }
 
     for (unsigned int i = _nTrackTrig; i < _nTrackTrig * 2; ++i) {
       occInfoDir->mkdir(Form("occInfoHel_%i", i));
       this->Hist._hOccInfo[i][0] = new TH1F(
           Form("hInstLum_%i", i),
-          "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+          "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+          lum.x.max);
 
       this->Hist._h2DOccInfo[i][0] =
           new TH2F(Form("hNSDVsLum_%i", i),
-                   "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6,
-                   4e8, 5000, 0., 20000.);
+                   "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n,
+                   nsd.x.min, nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
       this->Hist._h2DOccInfo[i][1] =
           new TH2F(Form("hNCDVsLum_%i", i),
-                   "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", 1000, 1e6,
-                   4e8, 5000, 0., 20000.);
+                   "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", ncd.x.n,
+                   ncd.x.min, ncd.x.max, ncd.y.n, ncd.y.min, ncd.y.max);
     }
 
     for (unsigned int i = _nTrackTrig * 2; i < _nTrackTrig * 2 + _nCaloTrig;
@@ -144,32 +164,34 @@ public:
       occInfoDir->mkdir(Form("occInfoCaloTrig_%i", i));
       this->Hist._hOccInfo[i][0] = new TH1F(
           Form("hInstLum_%i", i),
-          "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+          "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+          lum.x.max);
 
       this->Hist._h2DOccInfo[i][0] =
           new TH2F(Form("hNSDVsLum_%i", i),
-                   "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6,
-                   4e8, 5000, 0., 20000.);
+                   "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n,
+                   nsd.x.min, nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
       this->Hist._h2DOccInfo[i][1] =
           new TH2F(Form("hNCDVsLum_%i", i),
-                   "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", 1000, 1e6,
-                   4e8, 5000, 0., 20000.);
+                   "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", ncd.x.n,
+                   ncd.x.min, ncd.x.max, ncd.y.n, ncd.y.min, ncd.y.max);
     }
 
     unsigned int index_last = _nTrackTrig + _nCaloTrig;
     occInfoDir->mkdir("occInfoGeneral");
     this->Hist._hOccInfo[index_last][0] = new TH1F(
         Form("hInstLum_%i", index_last),
-        "distrbution of instantaneous lum; p/#mu-bunch", 1000, 1e6, 4e8);
+        "distrbution of instantaneous lum; p/#mu-bunch", lum.x.n, lum.x.min,
+        lum.x.max);
 
     this->Hist._h2DOccInfo[index_last][0] =
         new TH2F(Form("hNSDVsLum_%i", index_last),
-                 "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", 1000, 1e6,
-                 4e8, 5000, 0., 20000.);
+                 "inst lum vs nStrawDigi; p/#mu-bunch; nStrawDigi", nsd.x.n,
+                 nsd.x.min, nsd.x.max, nsd.y.n, nsd.y.min, nsd.y.max);
     this->Hist._h2DOccInfo[index_last][1] =
         new TH2F(Form("hNCDVsLum_%i", index_last),
-                 "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", 1000, 1e6,
-                 4e8, 5000, 0., 20000.);
+                 "inst lum vs nCaloDigi; p/#mu-bunch; nCaloDigi", ncd.x.n,
+                 ncd.x.min, ncd.x.max, ncd.y.n, ncd.y.min, ncd.y.max);
   }
 };
 
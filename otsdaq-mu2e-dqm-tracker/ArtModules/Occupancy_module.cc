@@ -60,17 +60,20 @@
 #include <Offline/MCDataProducts/inc/ProtonBunchIntensity.hh>
 
 // OTS:
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/FrameCompressor.h"
 #include "otsdaq-mu2e-dqm-tracker/ArtModules/OccupancyRootObjects.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/PublishStamp.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/PublishHub.hh"
 #include "otsdaq/Macros/CoutMacros.h"
 #include "otsdaq/Macros/ProcessorPluginMacros.h"
 #include "otsdaq/MessageFacility/MessageFacility.h"
-#include "otsdaq/NetworkUtilities/TCPPublishServer.h"
 // C++:
 #include <algorithm>
 #include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <unordered_map>
@@ -119,7 +122,14 @@ private:
 
   const art::Event *_event;
   OccupancyRootObjects *rootobjects = new OccupancyRootObjects("occ_plots");
-  TCPPublishServer *tcp;
+  std::shared_ptr<PublishHub> hub_;
+  std::string topic_;
+  HistoSpecTable histoSpecs_;
+  std::unique_ptr<TH1D> publishStamp_;
+  uint64_t publishCount_;
+  FrameCompressor compressor_;
+
+  void broadcast_(const TBufferFile &message);
 };
 } // namespace ots
 
@@ -140,7 +150,26 @@ ots::Occupancy::Occupancy(fhicl::ParameterSet const &pset)
       _nProcess(pset.get<float>("nEventsProcessed", 1.)),
       _nTrackTrig(pset.get<size_t>("nTrackTriggers", 4)),
       _nCaloTrig(pset.get<size_t>("nCaloTriggers", 4)),
-      tcp(new TCPPublishServer(pset.get<int>("listenPort", 6000))) {
+      hub_(PublishHub::get(pset.get<int>("listenPort", 6000),
+                           pset.get<size_t>("maxClientQueueBytes", 64 << 20))),
+      topic_(pset.get<std::string>("topic", "Occupancy")),
+      publishStamp_(pset.get<bool>("publishStamp", false)
+                        ? PublishStamp::book("Occupancy")
+                        : nullptr),
+      publishCount_(0),
+      compressor_(pset.get<std::string>("compression", "none"),
+                  pset.get<int>("compressionLevel", 3),
+                  pset.get<unsigned>("compressionMinBytes", 4096),
+                  pset.get<unsigned>("compressionZstdBytes", 1u << 20)) {
+  if (!compressor_.ok()) {
+    TLOG(TLVL_ERROR) << "compression "
+                     << pset.get<std::string>("compression", "none")
+                     << " is unknown or not built in, sending uncompressed";
+  }
+  for (const std::string &error : histoSpecs_.load(pset.get<fhicl::ParameterSet>(
+           "histoBinning", fhicl::ParameterSet()))) {
+    TLOG(TLVL_ERROR) << "histoBinning: " << error << ", keeping the default";
+  }
   TLOG(TLVL_INFO) << "Occuapncy Plotter construction is beginning ";
 
   TLOG(TLVL_DEBUG) << "TriggerRate Plotter construction complete";
@@ -150,7 +179,7 @@ ots::Occupancy::~Occupancy() {}
 
 void ots::Occupancy::beginJob() {
   TLOG(TLVL_INFO) << "Started";
-  rootobjects->BookHistos(tfs, _nTrackTrig, _nCaloTrig);
+  rootobjects->BookHistos(tfs, _nTrackTrig, _nCaloTrig, histoSpecs_);
 }
 
 void ots::Occupancy::analyze(art::Event const &event) {
@@ -194,10 +223,39 @@ void ots::Occupancy::analyze(art::Event const &event) {
 
   TBufferFile message(TBuffer::kWrite);
   message.WriteObject(rootobjects->Hist._hOccInfo[0][0]);
-  tcp->broadcastPacket(message.Buffer(), message.Length());
+  broadcast_(message);
+
+  if (publishStamp_) {
+    PublishStamp::stamp(publishStamp_.get(), publishCount_);
+    TBufferFile stamp(TBuffer::kWrite);
+    stamp.WriteObject(publishStamp_.get());
+    broadcast_(stamp);
+  }
+  ++publishCount_;
 }
 
-void ots::Occupancy::endJob() { TLOG(TLVL_INFO) << "Completed"; }
+// compressed when configured and worth it, as is otherwise
+void ots::Occupancy::broadcast_(const TBufferFile &message) {
+  FrameCompressor::Packet packet =
+      compressor_.compress(message.Buffer(), message.Length());
+  if (hub_)
+    hub_->publish(topic_, packet.data, packet.size);
+}
+
+void ots::Occupancy::endJob() {
+  if (compressor_.enabled()) {
+    TLOG(TLVL_INFO) << "Packet compression\n" << compressor_.summary();
+  }
+  if (hub_) {
+    PublishHub::Stats stats = hub_->stats();
+    TLOG(TLVL_INFO) << "Port " << hub_->port() << ": " << stats.published
+                    << " packets published, " << stats.sentBytes
+                    << " bytes sent, " << stats.evicted
+                    << " slow clients dropped";
+  }
+  hub_.reset();
+  TLOG(TLVL_INFO) << "Completed";
+}
 
 void ots::Occupancy::beginRun(const art::Run &run) {}
 
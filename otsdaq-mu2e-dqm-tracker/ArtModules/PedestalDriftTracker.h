@@ -0,0 +1,112 @@
+// Streaming per-straw pedestal statistics for trackerDQM: exponentially
+// weighted mean, variance and drift slope kept in flat per-channel arrays, so
+// that only the drifting channels need to be published.
+#ifndef _PedestalDriftTracker_h_
+#define _PedestalDriftTracker_h_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace ots {
+
+  class PedestalDriftTracker {
+  public:
+    struct Alarm {
+      uint16_t channel;
+      float    mean;
+      float    rms;
+      float    drift;  // mean - reference, in ADC counts
+      float    slope;  // smoothed mean change per hit, in ADC counts
+    };
+
+    PedestalDriftTracker(size_t nChannels, float alpha, float threshold, uint32_t warmup)
+      : alpha_(alpha), threshold_(threshold), warmup_(std::max<uint32_t>(warmup, 1)),
+	mean_(nChannels, 0.f), var_(nChannels, 0.f), slope_(nChannels, 0.f),
+	reference_(nChannels, 0.f), nHits_(nChannels, 0), flags_(nChannels, 0) {}
+
+    size_t channels() const { return mean_.size(); }
+
+    // Update a batch of hits; channels[i] is the unique straw index of values[i].
+    // Channels outside the tracker are dropped: fill_tracker_hit only passes
+    // straw ids it has checked, the test here keeps a bad index off the heap.
+    // This is a scalar scatter, one channel update per hit, and deliberately not
+    // vectorized: hits of the same channel must be applied in order, so a SIMD
+    // version has to group the batch into rounds of distinct channels and
+    // gather/scatter the state around each round. With a few hundred hits over
+    // 20k channels those extra memory passes cost about 3x what the SIMD
+    // arithmetic saves. Apart from the never-taken range check the body has no
+    // branches (the reference update is a select) and each quantity has its
+    // own array.
+    void update(const uint16_t* channels, const float* values, size_t n) {
+      float*    mean  = mean_.data();
+      float*    var   = var_.data();
+      float*    slope = slope_.data();
+      float*    ref   = reference_.data();
+      uint32_t* nHits = nHits_.data();
+      const size_t nChannels = mean_.size();
+      for (size_t i = 0; i < n; ++i) {
+	const uint16_t c  = channels[i];
+	if (c >= nChannels) continue;
+	const uint32_t nc = ++nHits[c];
+	// start as a cumulative average so the first hits converge quickly
+	const float w    = std::max(alpha_, 1.f / float(nc));
+	const float d    = values[i] - mean[c];
+	const float step = w * d;
+	mean[c]  += step;
+	var[c]    = (1.f - w) * (var[c] + step * d);
+	slope[c] += alpha_ * (step - slope[c]);
+	ref[c]    = (nc == warmup_) ? mean[c] : ref[c];
+      }
+    }
+
+    void update(const std::vector<uint16_t>& channels, const std::vector<float>& values) {
+      update(channels.data(), values.data(), std::min(channels.size(), values.size()));
+    }
+
+    // Collect the channels whose mean moved by more than the threshold since the
+    // end of the warm-up period. The flag pass is a plain loop over contiguous
+    // arrays, only the (few) flagged channels are visited a second time.
+    const std::vector<Alarm>& findAlarms() {
+      const size_t n = mean_.size();
+      for (size_t c = 0; c < n; ++c) {
+	flags_[c] = (nHits_[c] >= warmup_) &
+		    (std::fabs(mean_[c] - reference_[c]) > threshold_);
+      }
+      alarms_.clear();
+      for (size_t c = 0; c < n; ++c) {
+	if (!flags_[c]) continue;
+	alarms_.push_back(Alarm{uint16_t(c), mean_[c], std::sqrt(var_[c]),
+				mean_[c] - reference_[c], slope_[c]});
+      }
+      return alarms_;
+    }
+
+    const std::vector<Alarm>& alarms() const { return alarms_; }
+
+    void reset() {
+      std::fill(mean_.begin(), mean_.end(), 0.f);
+      std::fill(var_.begin(), var_.end(), 0.f);
+      std::fill(slope_.begin(), slope_.end(), 0.f);
+      std::fill(reference_.begin(), reference_.end(), 0.f);
+      std::fill(nHits_.begin(), nHits_.end(), 0);
+      alarms_.clear();
+    }
+
+  private:
+    float                 alpha_;
+    float                 threshold_;
+    uint32_t              warmup_;
+    std::vector<float>    mean_;
+    std::vector<float>    var_;
+    std::vector<float>    slope_;
+    std::vector<float>    reference_;
+    std::vector<uint32_t> nHits_;
+    std::vector<uint8_t>  flags_;
+    std::vector<Alarm>    alarms_;
+  };
+
+} // namespace ots
+
+#endif
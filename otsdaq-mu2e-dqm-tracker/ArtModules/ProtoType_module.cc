@@ -79,10 +79,10 @@
 
 // OTS:
 #include "otsdaq-dqm/ArtModules/ProtoTypeHistos.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/PublishHub.hh"
 #include "otsdaq/Macros/CoutMacros.h"
 #include "otsdaq/Macros/ProcessorPluginMacros.h"
 #include "otsdaq/MessageFacility/MessageFacility.h"
-#include "otsdaq/NetworkUtilities/TCPPublishServer.h"
 // C++:
 #include <algorithm>
 #include <functional>
@@ -134,7 +134,8 @@ private:
 
   const art::Event *_event;
   ProtoTypeHistos *histos = new ProtoTypeHistos("test");
-  TCPPublishServer *tcp;
+  std::shared_ptr<PublishHub> hub_;
+  std::string topic_;
 };
 } // namespace ots
 
@@ -151,7 +152,9 @@ ots::ProtoType::ProtoType(fhicl::ParameterSet const &pset)
       _duty_cycle(pset.get<float>("dutyCycle", 1.)),
       _processName(pset.get<string>("processName", "globalTrigger")),
       _nProcess(pset.get<float>("nEventsProcessed", 1.)),
-      tcp(new TCPPublishServer(pset.get<int>("listenPort", 6000))) {
+      hub_(PublishHub::get(pset.get<int>("listenPort", 6000),
+                           pset.get<size_t>("maxClientQueueBytes", 64 << 20))),
+      topic_(pset.get<std::string>("topic", "ProtoType")) {
   TLOG(TLVL_INFO) << "TriggerRate Plotter construction is beginning ";
 
   TLOG(TLVL_DEBUG) << "TriggerRate Plotter construction complete";
@@ -173,10 +176,14 @@ void ots::ProtoType::analyze(art::Event const &event) {
   message.WriteObject(histos->Test._FirstHist);
 
   //__CFG_COUT__ << "Broadcasting!" << std::endl;
-  tcp->broadcastPacket(message.Buffer(), message.Length());
+  if (hub_)
+    hub_->publish(topic_, message.Buffer(), message.Length());
 }
 
-void ots::ProtoType::endJob() { TLOG(TLVL_INFO) << "Completed"; }
+void ots::ProtoType::endJob() {
+  hub_.reset();
+  TLOG(TLVL_INFO) << "Completed";
+}
 
 void ots::ProtoType::beginRun(const art::Run &run) {}
 
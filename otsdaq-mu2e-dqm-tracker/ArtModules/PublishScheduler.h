@@ -0,0 +1,84 @@
+// Wall-clock publish deadlines for groups of DQM histograms. Each timed group
+// publishes every `interval` seconds on a fixed grid (start + k * interval), so
+// late publishes do not push the following ones back and missed slots are
+// skipped rather than sent in a burst. Groups without an interval are left to
+// the event-count schedule (freqDQM).
+#ifndef _PublishScheduler_h_
+#define _PublishScheduler_h_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace ots {
+
+  class PublishScheduler {
+  public:
+    typedef std::chrono::steady_clock Clock;
+    typedef uint32_t                  GroupMask;  // bit g set: group g
+
+    explicit PublishScheduler(int nGroups) : groups_(nGroups), skipped_(0) {}
+
+    // seconds <= 0: the group is not time-scheduled
+    void setInterval(int group, double seconds) {
+      groups_[group].interval = std::chrono::duration_cast<Clock::duration>(
+				  std::chrono::duration<double>(seconds > 0 ? seconds : 0));
+    }
+
+    bool timed(int group) const { return groups_[group].interval.count() > 0; }
+
+    GroupMask timedGroups() const {
+      GroupMask mask = 0;
+      for (size_t g = 0; g < groups_.size(); ++g) {
+	if (timed(g)) mask |= GroupMask(1) << g;
+      }
+      return mask;
+    }
+    GroupMask untimedGroups() const {
+      return ~timedGroups() & ((GroupMask(1) << groups_.size()) - 1);
+    }
+
+    void start(Clock::time_point now) {
+      for (auto& g : groups_) g.deadline = now + g.interval;
+    }
+
+    // earliest deadline of the timed groups, time_point::max() if there is none
+    Clock::time_point next() const {
+      Clock::time_point t = Clock::time_point::max();
+      for (const auto& g : groups_) {
+	if (g.interval.count() > 0 && g.deadline < t) t = g.deadline;
+      }
+      return t;
+    }
+
+    // Groups whose deadline has passed; their deadlines move to the first
+    // grid point after `now`
+    GroupMask due(Clock::time_point now) {
+      GroupMask mask = 0;
+      for (size_t i = 0; i < groups_.size(); ++i) {
+	Group& g = groups_[i];
+	if (g.interval.count() <= 0 || now < g.deadline) continue;
+	mask |= GroupMask(1) << i;
+	auto periods = (now - g.deadline) / g.interval + 1;
+	skipped_    += periods - 1;
+	g.deadline  += periods * g.interval;
+      }
+      return mask;
+    }
+
+    // grid points missed because a publish ran late
+    uint64_t skipped() const { return skipped_; }
+
+  private:
+    struct Group {
+      Clock::duration   interval{0};
+      Clock::time_point deadline;
+    };
+
+    std::vector<Group> groups_;
+    uint64_t           skipped_;
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,60 @@
+// A three-bin TH1D sent after the histograms of each DQM publish: publish
+// sequence number, and system_clock send time split in seconds and nanoseconds.
+// It lets a receiver (tools/HistoLoopbackReceiver) measure the end-to-end
+// latency and count lost publishes without changing the histogram payloads.
+#ifndef _PublishStamp_h_
+#define _PublishStamp_h_
+
+#include <TH1D.h>
+#include <TObject.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ots {
+
+  struct PublishStamp {
+    uint64_t sequence;
+    int64_t  sendNs;   // ns since the system_clock epoch
+
+    static constexpr const char* kSuffix = "_publishStamp";
+
+    static int64_t nowNs() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	       std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // detached histogram carrying the stamp, named <tag>_publishStamp; no ROOT
+    // directory owns it, the caller does
+    static std::unique_ptr<TH1D> book(const std::string& tag) {
+      std::unique_ptr<TH1D> h(new TH1D((tag + kSuffix).c_str(), "publish sequence, send time [s], [ns]", 3, 0, 3));
+      h->SetDirectory(nullptr);
+      return h;
+    }
+
+    // write the next sequence number and the current time; doubles hold both exactly
+    static void stamp(TH1D* h, uint64_t sequence) {
+      int64_t ns = nowNs();
+      h->SetBinContent(1, double(sequence));
+      h->SetBinContent(2, double(ns / 1000000000));
+      h->SetBinContent(3, double(ns % 1000000000));
+    }
+
+    // fill `out` if `obj` is a publish stamp
+    static bool read(const TObject* obj, PublishStamp& out) {
+      const TH1D* h = dynamic_cast<const TH1D*>(obj);
+      if (h == nullptr || h->GetNbinsX() != 3) return false;
+      std::string name = h->GetName();
+      size_t      n    = std::char_traits<char>::length(kSuffix);
+      if (name.size() < n || name.compare(name.size() - n, n, kSuffix) != 0) return false;
+      out.sequence = uint64_t(h->GetBinContent(1));
+      out.sendNs   = int64_t(h->GetBinContent(2)) * 1000000000 + int64_t(h->GetBinContent(3));
+      return true;
+    }
+  };
+
+} // namespace ots
+
+#endif
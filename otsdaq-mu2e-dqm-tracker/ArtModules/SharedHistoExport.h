@@ -0,0 +1,328 @@
+// Export of the DQM histograms through a POSIX shared-memory segment, for
+// consumers on the same node: they map the segment read-only and read the bin
+// arrays in place, with no TCP and no serialization.
+//
+// Layout: a Header, a directory with one Entry per histogram (fixed once the
+// segment is created), then two data slots. Each slot holds, per histogram,
+// the entries and TH1::GetStats sums followed by the bin array (float or
+// double, under/overflows included). The writer fills the slot not holding the
+// latest version, bracketing the copy with an odd/even sequence number (a
+// seqlock), then publishes the new version. A reader looks at the latest slot
+// and checks that its sequence number was even and unchanged across the read;
+// with two slots a read only fails if the writer publishes twice meanwhile.
+#ifndef _SharedHistoExport_h_
+#define _SharedHistoExport_h_
+
+#include <TH1.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace ots {
+
+  namespace SharedHisto {
+
+    const uint32_t kMagic   = 0x58454853;  // "SHEX" in a little-endian dump
+    const uint32_t kVersion = 1;
+    const int      kStats   = 8;           // entries, then the 7 TH1::GetStats sums
+
+    enum Content : uint8_t { kFloat = 0, kDouble = 1 };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs lock-free 64-bit atomics");
+
+    struct Header {
+      uint32_t              magic;
+      uint32_t              version;
+      uint64_t              segmentBytes;
+      uint64_t              layoutId;         // creation time: changes when the segment is re-created
+      uint32_t              histograms;
+      uint32_t              reserved;
+      uint64_t              directoryOffset;
+      uint64_t              slotOffset[2];
+      alignas(64) std::atomic<uint64_t> published;  // completed updates; the latest is in slot published % 2
+    };
+
+    struct Slot {
+      alignas(64) std::atomic<uint64_t> sequence;  // odd while the writer is copying
+      uint64_t              update;            // `published` value this slot holds
+      int64_t               publishNs;         // system_clock time of the update
+    };
+
+    struct Entry {
+      char     group[64];   // null-terminated, truncated if longer
+      char     name[96];
+      uint8_t  dimension;
+      uint8_t  content;     // Content
+      uint16_t reserved;
+      uint32_t nx;
+      uint32_t ny;          // 0 for 1D histograms
+      uint32_t reserved2;
+      double   xmin, xmax, ymin, ymax;
+      uint64_t cells;
+      uint64_t offset;      // of the stats block in a slot, from the slot start
+    };
+
+    // One histogram of a slot, pointing into the mapped segment
+    struct View {
+      const Entry*  entry;
+      const double* stats;     // kStats values
+      const char*   contents;  // entry->cells floats or doubles
+
+      double content(size_t cell) const {
+	return entry->content == kFloat ? reinterpret_cast<const float*>(contents)[cell]
+	                                : reinterpret_cast<const double*>(contents)[cell];
+      }
+    };
+
+    inline size_t aligned(size_t n) { return (n + 63) & ~size_t(63); }
+
+    // Owner side: registers the histograms, creates the segment, then copies
+    // the bin arrays in on every update()
+    class Writer {
+    public:
+      explicit Writer(const std::string& name) : name_(name), base_(nullptr), bytes_(0), published_(0) {}
+      ~Writer() { close(); }
+      Writer(const Writer&) = delete;
+      Writer& operator=(const Writer&) = delete;
+
+      // before create(); histograms of more than two dimensions are skipped.
+      // The directory records the binning once: a histogram must keep it (no
+      // SetBins) while exported, and its bin labels are not exported
+      void add(const std::string& group, const TH1* h) {
+	if (h->GetDimension() <= 2) histos_.push_back(Source{group, h});
+      }
+
+      // false (with errno set) if the segment cannot be created
+      bool create() {
+	Entry  entry;
+	size_t slotBytes = aligned(sizeof(Slot));
+	entries_.clear();
+	for (const auto& source : histos_) {
+	  const TH1* h = source.histo;
+	  std::memset(&entry, 0, sizeof(entry));
+	  std::strncpy(entry.group, source.group.c_str(), sizeof(entry.group) - 1);
+	  std::strncpy(entry.name, h->GetName(), sizeof(entry.name) - 1);
+	  entry.dimension = h->GetDimension();
+	  entry.content   = dynamic_cast<const TArrayF*>(h) ? kFloat : kDouble;
+	  entry.nx        = h->GetNbinsX();
+	  entry.ny        = entry.dimension == 2 ? h->GetNbinsY() : 0;
+	  entry.xmin      = h->GetXaxis()->GetXmin();
+	  entry.xmax      = h->GetXaxis()->GetXmax();
+	  entry.ymin      = entry.dimension == 2 ? h->GetYaxis()->GetXmin() : 0;
+	  entry.ymax      = entry.dimension == 2 ? h->GetYaxis()->GetXmax() : 0;
+	  entry.cells     = size_t(entry.nx + 2) * (entry.dimension == 2 ? entry.ny + 2 : 1);
+	  entry.offset    = slotBytes;
+	  slotBytes      += aligned(kStats * sizeof(double) +
+				    entry.cells * (entry.content == kFloat ? sizeof(float) : sizeof(double)));
+	  entries_.push_back(entry);
+	}
+
+	size_t directory = aligned(sizeof(Header));
+	size_t slot0     = aligned(directory + entries_.size() * sizeof(Entry));
+	bytes_           = slot0 + 2 * slotBytes;
+
+	::shm_unlink(name_.c_str());  // a stale segment may have another layout
+	int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) return false;
+	if (::ftruncate(fd, bytes_) != 0) {
+	  ::close(fd);
+	  ::shm_unlink(name_.c_str());
+	  return false;
+	}
+	void* base = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED) {
+	  ::shm_unlink(name_.c_str());
+	  return false;
+	}
+	base_ = static_cast<char*>(base);
+
+	// ftruncate zero-filled the segment: sequences and `published` start at 0
+	Header* header          = new (base_) Header;
+	header->version         = kVersion;
+	header->segmentBytes    = bytes_;
+	header->layoutId        = std::chrono::system_clock::now().time_since_epoch().count();
+	header->histograms      = entries_.size();
+	header->directoryOffset = directory;
+	header->slotOffset[0]   = slot0;
+	header->slotOffset[1]   = slot0 + slotBytes;
+	header->published.store(0, std::memory_order_relaxed);
+	std::memcpy(base_ + directory, entries_.data(), entries_.size() * sizeof(Entry));
+	for (int s = 0; s < 2; ++s) new (base_ + header->slotOffset[s]) Slot{{0}, 0, 0};
+	// magic last: a reader opening the segment meanwhile sees it incomplete
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = kMagic;
+	return true;
+      }
+
+      bool open() const { return base_ != nullptr; }
+      const std::string& name() const { return name_; }
+      size_t bytes() const { return bytes_; }
+
+      // Copy every registered histogram into the free slot and publish it;
+      // the caller keeps the histograms from being filled meanwhile
+      void update(int64_t publishNs) {
+	if (!base_) return;
+	Header*  header = reinterpret_cast<Header*>(base_);
+	uint64_t next   = published_ + 1;
+	char*    slot   = base_ + header->slotOffset[next % 2];
+	Slot*    s      = reinterpret_cast<Slot*>(slot);
+	uint64_t seq    = s->sequence.load(std::memory_order_relaxed);
+	s->sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	double stats[13];  // TH1::kNstat
+	for (size_t i = 0; i < histos_.size(); ++i) {
+	  const TH1*   h     = histos_[i].histo;
+	  const Entry& entry = entries_[i];
+	  double*      out   = reinterpret_cast<double*>(slot + entry.offset);
+	  std::memset(stats, 0, sizeof(stats));
+	  h->GetStats(stats);
+	  out[0] = h->GetEntries();
+	  std::memcpy(out + 1, stats, (kStats - 1) * sizeof(double));
+	  char* contents = reinterpret_cast<char*>(out + kStats);
+	  if (const TArrayF* f = dynamic_cast<const TArrayF*>(h)) {
+	    std::memcpy(contents, f->GetArray(), entry.cells * sizeof(float));
+	  } else if (const TArrayD* d = dynamic_cast<const TArrayD*>(h)) {
+	    std::memcpy(contents, d->GetArray(), entry.cells * sizeof(double));
+	  } else {
+	    double* values = reinterpret_cast<double*>(contents);
+	    for (size_t c = 0; c < entry.cells; ++c) values[c] = h->GetBinContent(int(c));
+	  }
+	}
+	s->update    = next;
+	s->publishNs = publishNs;
+	s->sequence.store(seq + 2, std::memory_order_release);
+	header->published.store(next, std::memory_order_release);
+	published_ = next;
+      }
+
+      // unlink: remove the name too, so consumers know the producer is gone
+      void close(bool unlink = true) {
+	if (!base_) return;
+	::munmap(base_, bytes_);
+	if (unlink) ::shm_unlink(name_.c_str());
+	base_ = nullptr;
+      }
+
+    private:
+      struct Source {
+	std::string group;
+	const TH1*  histo;
+      };
+
+      std::string         name_;
+      std::vector<Source> histos_;
+      std::vector<Entry>  entries_;
+      char*               base_;
+      size_t              bytes_;
+      uint64_t            published_;
+    };
+
+    // Consumer side: maps the segment read-only
+    class Reader {
+    public:
+      Reader() : base_(nullptr), bytes_(0) {}
+      ~Reader() { close(); }
+      Reader(const Reader&) = delete;
+      Reader& operator=(const Reader&) = delete;
+
+      // false if the segment does not exist (yet) or is not complete
+      bool open(const std::string& name) {
+	close();
+	int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return false;
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+	  ::close(fd);
+	  return false;
+	}
+	void* base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED) return false;
+	base_  = static_cast<const char*>(base);
+	bytes_ = st.st_size;
+	if (header().magic != kMagic || header().version != kVersion || header().segmentBytes != bytes_) {
+	  close();
+	  return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return true;
+      }
+
+      void close() {
+	if (base_) ::munmap(const_cast<char*>(base_), bytes_);
+	base_ = nullptr;
+      }
+
+      bool          isOpen() const { return base_ != nullptr; }
+      const Header& header() const { return *reinterpret_cast<const Header*>(base_); }
+      size_t        size() const { return header().histograms; }
+      const Entry&  entry(size_t i) const {
+	return reinterpret_cast<const Entry*>(base_ + header().directoryOffset)[i];
+      }
+      // number of updates published so far, 0 before the first one
+      uint64_t published() const { return header().published.load(std::memory_order_acquire); }
+
+      // Call f(index, view) for every histogram of the latest update, reading
+      // in place. Returns false, possibly after calling f on torn data, if the
+      // writer overwrote the slot meanwhile: the caller then discards what f
+      // saw and tries again.
+      template <class F>
+      bool read(F&& f, uint64_t* update = nullptr, int64_t* publishNs = nullptr) const {
+	uint64_t    latest = published();
+	if (latest == 0) return false;
+	const char* slot   = base_ + header().slotOffset[latest % 2];
+	const Slot* s      = reinterpret_cast<const Slot*>(slot);
+	uint64_t    seq    = s->sequence.load(std::memory_order_acquire);
+	if (seq & 1) return false;
+	if (update) *update = s->update;
+	if (publishNs) *publishNs = s->publishNs;
+	for (size_t i = 0; i < size(); ++i) {
+	  const Entry&  e     = entry(i);
+	  const double* stats = reinterpret_cast<const double*>(slot + e.offset);
+	  f(i, View{&e, stats, reinterpret_cast<const char*>(stats + kStats)});
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return s->sequence.load(std::memory_order_relaxed) == seq;
+      }
+
+      // Consistent private copy of the latest slot, for consumers that keep
+      // the data longer than a read() callback; View offsets apply to it
+      bool snapshot(std::vector<char>& out, int tries = 10) const {
+	for (int t = 0; t < tries; ++t) {
+	  uint64_t latest = published();
+	  if (latest == 0) return false;
+	  uint64_t    offset = header().slotOffset[latest % 2];
+	  size_t      bytes  = header().slotOffset[1] - header().slotOffset[0];
+	  const Slot* s      = reinterpret_cast<const Slot*>(base_ + offset);
+	  uint64_t    seq    = s->sequence.load(std::memory_order_acquire);
+	  if (seq & 1) continue;
+	  out.resize(bytes);
+	  std::memcpy(out.data(), base_ + offset, bytes);
+	  std::atomic_thread_fence(std::memory_order_acquire);
+	  if (s->sequence.load(std::memory_order_relaxed) == seq) return true;
+	}
+	return false;
+      }
+
+    private:
+      const char* base_;
+      size_t      bytes_;
+    };
+
+  } // namespace SharedHisto
+
+} // namespace ots
+
+#endif
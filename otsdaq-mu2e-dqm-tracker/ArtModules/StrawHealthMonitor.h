@@ -0,0 +1,102 @@
+// Incremental per-straw hit counting for trackerDQM. Every check period the
+// straw counts of each panel are compared with the panel median and the dead
+// and hot straws are kept in two short lists for publishing.
+#ifndef _StrawHealthMonitor_h_
+#define _StrawHealthMonitor_h_
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/BinMerge.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace ots {
+
+  class StrawHealthMonitor {
+  public:
+    struct Flag {
+      uint16_t channel;
+      float    ratio;  // straw count / panel median
+    };
+
+    // channelsPerPanel consecutive channels form one panel
+    StrawHealthMonitor(size_t nChannels, size_t channelsPerPanel, uint32_t period,
+		       float deadSigma, float hotSigma, float minMedian)
+      : channelsPerPanel_(channelsPerPanel), period_(std::max<uint32_t>(period, 1)),
+	deadSigma_(deadSigma), hotSigma_(hotSigma), minMedian_(minMedian),
+	nEvents_(0), counts_(nChannels, 0), scratch_(channelsPerPanel, 0) {}
+
+    // channels outside the monitor are dropped; fill_tracker_hit only passes
+    // straw ids it has checked
+    void fill(uint16_t channel) {
+      if (channel < counts_.size()) ++counts_[channel];
+    }
+
+    // Add the counts of a monitor filled by another thread, which starts over
+    void merge(StrawHealthMonitor& from) {
+      detail::move_bins(counts_.data(), from.counts_.data(), std::min(counts_.size(), from.counts_.size()));
+    }
+
+    // true when the next endEvent runs the check
+    bool checkDue() const { return nEvents_ + 1 >= period_; }
+
+    // Returns true when a new set of flags has been produced
+    bool endEvent() {
+      if (++nEvents_ < period_) return false;
+      check();
+      return true;
+    }
+
+    // Compare every straw with the median of its panel using the Poisson
+    // significance of the difference, then start a new counting window.
+    void check() {
+      dead_.clear();
+      hot_.clear();
+      for (size_t first = 0; first + channelsPerPanel_ <= counts_.size(); first += channelsPerPanel_) {
+	std::copy(counts_.begin() + first, counts_.begin() + first + channelsPerPanel_, scratch_.begin());
+	auto mid = scratch_.begin() + channelsPerPanel_ / 2;
+	std::nth_element(scratch_.begin(), mid, scratch_.end());
+	float median = *mid;
+	if (median < minMedian_) continue;  // not enough statistics, or the whole panel is off
+
+	float sigma = std::sqrt(median);
+	for (size_t c = first; c < first + channelsPerPanel_; ++c) {
+	  float pull = (counts_[c] - median) / sigma;
+	  if (pull < -deadSigma_) {
+	    dead_.push_back(Flag{uint16_t(c), counts_[c] / median});
+	  } else if (pull > hotSigma_) {
+	    hot_.push_back(Flag{uint16_t(c), counts_[c] / median});
+	  }
+	}
+      }
+      std::fill(counts_.begin(), counts_.end(), 0);
+      nEvents_ = 0;
+    }
+
+    const std::vector<Flag>& dead() const { return dead_; }
+    const std::vector<Flag>& hot() const { return hot_; }
+
+    void reset() {
+      std::fill(counts_.begin(), counts_.end(), 0);
+      nEvents_ = 0;
+      dead_.clear();
+      hot_.clear();
+    }
+
+  private:
+    size_t                channelsPerPanel_;
+    uint32_t              period_;
+    float                 deadSigma_;
+    float                 hotSigma_;
+    float                 minMedian_;
+    uint32_t              nEvents_;
+    std::vector<uint32_t> counts_;
+    std::vector<uint32_t> scratch_;
+    std::vector<Flag>     dead_;
+    std::vector<Flag>     hot_;
+  };
+
+} // namespace ots
+
+#endif
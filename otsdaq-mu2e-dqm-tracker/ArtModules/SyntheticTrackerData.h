@@ -0,0 +1,161 @@
+// Synthetic tracker data for trackerDQM benchmarks and emulators: per-straw
+// hits with ADC waveforms, TDC and TOT values, packed as the DTC data blocks
+// read by mu2e::TrackerFragment (one data block per ROC link, one panel per ROC).
+#ifndef _SyntheticTrackerData_h_
+#define _SyntheticTrackerData_h_
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerChannelLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace ots {
+
+  struct SyntheticTrackerConfig {
+    double   occupancy     = 0.01;  // mean probability for a straw to be hit in an event
+    double   radialSlope   = 1.;    // straw 0 sees (1+radialSlope) times the rate of the last straw
+    unsigned adcSamples    = 15;    // waveform length: 3 samples in the hit packet, 12 per ADC packet
+    double   pedestalMean  = 100.;  // ADC counts
+    double   pedestalSpread= 10.;   // straw-to-straw pedestal spread
+    double   noise         = 2.;    // sample-to-sample noise
+    double   pulseHeight   = 200.;
+    double   deadFraction  = 0.;    // fraction of straws that never fire
+    double   hotFraction   = 0.;    // fraction of straws firing 10 times more often
+    unsigned linksPerDTC   = 6;     // one tracker DTC fragment per linksPerDTC panels
+    uint8_t  dataVersion   = 1;
+    uint32_t seed          = 12345;
+  };
+
+  template <class Layout = TrackerLayout>
+  class SyntheticTrackerData {
+  public:
+    // DTC data format, see DTC_DataHeaderPacket and TrackerFragment::TrackerDataPacket
+    enum { kPacketBytes = 16, kDataHeaderType = 5, kADCBits = 10, kFirstPacketSamples = 3,
+	   kADCPacketSamples = 12, kMaxADCPackets = 15, kHitFixedBits = 94 };
+
+    explicit SyntheticTrackerData(const SyntheticTrackerConfig& config)
+      : config_(config), rng_(config.seed), uniform_(0., 1.), noise_(0., config.noise),
+	rate_(Layout::kNChannels), pedestal_(Layout::kNChannels) {
+      nADCPackets_ = config.adcSamples > kFirstPacketSamples
+	? std::min<unsigned>((config.adcSamples - kFirstPacketSamples + kADCPacketSamples - 1) / kADCPacketSamples,
+			     kMaxADCPackets)
+	: 0;
+      std::normal_distribution<double> spread(config.pedestalMean, config.pedestalSpread);
+      for (int c = 0; c < Layout::kNChannels; ++c) {
+	double radial = 1. + config.radialSlope * (1. - double(Layout::straw(c)) / (Layout::kStraws - 1));
+	double rate   = config.occupancy * radial / (1. + 0.5 * config.radialSlope);
+	double kind   = uniform_(rng_);
+	if (kind < config.deadFraction) rate = 0.;
+	else if (kind < config.deadFraction + config.hotFraction) rate *= 10.;
+	rate_[c]     = std::min(rate, 1.);
+	pedestal_[c] = spread(rng_);
+      }
+    }
+
+    unsigned samples() const { return kFirstPacketSamples + kADCPacketSamples * nADCPackets_; }
+    unsigned fragmentsPerEvent() const {
+      return (Layout::kNPanels + config_.linksPerDTC - 1) / config_.linksPerDTC;
+    }
+
+    // Generate one event: fragments[i] is the payload of tracker DTC i. The
+    // buffers are reused from event to event. Returns the number of hits.
+    size_t makeEvent(uint64_t eventWindowTag, std::vector<std::vector<uint8_t>>& fragments) {
+      fragments.resize(fragmentsPerEvent());
+      for (auto& f : fragments) f.clear();
+      size_t nHits = 0;
+      for (int panel = 0; panel < Layout::kNPanels; ++panel) {
+	auto& out     = fragments[panel / config_.linksPerDTC];
+	size_t header = out.size();
+	out.resize(header + kPacketBytes);
+	unsigned hitsInBlock = 0;
+	for (int straw = 0; straw < Layout::kStraws; ++straw) {
+	  int channel = panel * Layout::kStraws + straw;
+	  if (uniform_(rng_) >= rate_[channel]) continue;
+	  appendHit(out, channel);
+	  ++hitsInBlock;
+	}
+	writeHeader(&out[header], uint16_t(out.size() - header), hitsInBlock * (1 + nADCPackets_),
+		    panel % config_.linksPerDTC, panel / config_.linksPerDTC, eventWindowTag);
+	nHits += hitsInBlock;
+      }
+      return nHits;
+    }
+
+    // shift the pedestal of one straw, to exercise the drift monitoring
+    void shiftPedestal(int channel, double delta) { pedestal_[channel] += delta; }
+
+  private:
+    static void put16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+
+    // LSB-first bit stream, the layout of the ADC bit fields in the packets
+    static void putBits(uint8_t* p, unsigned bitOffset, unsigned nBits, uint32_t value) {
+      for (unsigned i = 0; i < nBits; ++i, ++bitOffset) {
+	if (value & (1u << i)) p[bitOffset / 8] |= uint8_t(1u << (bitOffset % 8));
+      }
+    }
+
+    static void writeHeader(uint8_t* p, uint16_t byteCount, unsigned packetCount, int link, int dtc,
+			    uint64_t eventWindowTag) {
+      std::memset(p, 0, kPacketBytes);
+      put16(p, byteCount);
+      p[2] = kDataHeaderType;
+      p[3] = uint8_t(link & 0x7) | 0x80;  // link ID, valid bit
+      put16(p + 4, uint16_t(packetCount & 0x7FF));
+      for (int i = 0; i < 6; ++i) p[6 + i] = uint8_t(eventWindowTag >> (8 * i));
+      p[12] = 0;                           // status
+      p[13] = 1;                           // data packet version
+      p[14] = uint8_t(dtc);
+      p[15] = 0;                           // EVB mode
+    }
+
+    void appendHit(std::vector<uint8_t>& out, int channel) {
+      size_t first = out.size();
+      out.resize(first + kPacketBytes * (1 + nADCPackets_), 0);
+      uint8_t* p = &out[first];
+
+      uint16_t strawIndex = uint16_t((Layout::plane(channel) << 10) | (Layout::panel(channel) << 7) |
+				     Layout::straw(channel));
+      uint32_t tdc0 = uint32_t(uniform_(rng_) * 60000.);
+      uint32_t tdc1 = uint32_t(std::max(0., tdc0 + 300. * (uniform_(rng_) - 0.5)));
+      uint8_t  tot0 = uint8_t(uniform_(rng_) * 16);
+      uint8_t  tot1 = uint8_t(uniform_(rng_) * 16);
+
+      put16(p, strawIndex);
+      put16(p + 2, uint16_t(tdc0));
+      p[4] = uint8_t(tdc0 >> 16);
+      p[5] = tot0 & 0xF;
+      put16(p + 6, uint16_t(tdc1));
+      p[8] = uint8_t(tdc1 >> 16);
+      p[9] = tot1 & 0xF;
+      put16(p + 10, uint16_t(nADCPackets_ & 0xF));  // NumADCPackets, PMP = 0
+
+      unsigned nSamples = samples();
+      unsigned peak     = nSamples / 3;
+      for (unsigned i = 0; i < nSamples; ++i) {
+	double value = pedestal_[channel] + noise_(rng_);
+	if (i >= peak) value += config_.pulseHeight * (i - peak + 1) * std::exp(-double(i - peak));
+	uint32_t adc = uint32_t(std::min(std::max(value, 0.), double((1 << kADCBits) - 1)));
+	unsigned bit = i < kFirstPacketSamples
+	  ? kHitFixedBits + kADCBits * i
+	  : 8 * kPacketBytes * (1 + (i - kFirstPacketSamples) / kADCPacketSamples) +
+	    kADCBits * ((i - kFirstPacketSamples) % kADCPacketSamples);
+	putBits(p, bit, kADCBits, adc);
+      }
+    }
+
+    SyntheticTrackerConfig                 config_;
+    std::mt19937                           rng_;
+    std::uniform_real_distribution<double> uniform_;
+    std::normal_distribution<double>       noise_;
+    std::vector<double>                    rate_;
+    std::vector<double>                    pedestal_;
+    unsigned                               nADCPackets_;
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,48 @@
+// Flat channel numbering of the tracker used by the trackerDQM histogram
+// containers. The dimensions are template parameters so all index arithmetic
+// folds into constants.
+#ifndef _TrackerChannelLayout_h_
+#define _TrackerChannelLayout_h_
+
+#include "Offline/DataProducts/inc/StrawId.hh"
+
+namespace ots {
+
+  template <int NPlanes, int NPanels, int NStraws>
+  struct TrackerChannelLayout {
+    static constexpr int kPlanes     = NPlanes;
+    static constexpr int kPanels     = NPanels;
+    static constexpr int kStraws     = NStraws;
+    static constexpr int kNPanels    = NPlanes * NPanels;   // number of panels in the tracker
+    static constexpr int kNChannels  = kNPanels * NStraws;  // number of straws in the tracker
+
+    static constexpr int panelIndex(int plane, int panel) { return plane * NPanels + panel; }
+    static constexpr int strawIndex(int plane, int panel, int straw) {
+      return panelIndex(plane, panel) * NStraws + straw;
+    }
+
+    // the StrawId bit fields hold up to 64 planes, 8 panels and 128 straws:
+    // an id decoded from raw data must be checked before it is used as an index
+    static bool contains(const mu2e::StrawId& sid) {
+      return sid.plane() < NPlanes && sid.panel() < NPanels && sid.straw() < NStraws;
+    }
+
+    static int panelIndex(const mu2e::StrawId& sid) { return panelIndex(sid.plane(), sid.panel()); }
+    static int strawIndex(const mu2e::StrawId& sid) { return strawIndex(sid.plane(), sid.panel(), sid.straw()); }
+
+    // inverse of strawIndex
+    static constexpr int plane(int channel) { return channel / (NPanels * NStraws); }
+    static constexpr int panel(int channel) { return (channel / NStraws) % NPanels; }
+    static constexpr int straw(int channel) { return channel % NStraws; }
+  };
+
+  typedef TrackerChannelLayout<mu2e::StrawId::_nplanes, mu2e::StrawId::_npanels,
+			       mu2e::StrawId::_nstraws> TrackerLayout;
+
+  static_assert(TrackerLayout::strawIndex(1, 2, 3) ==
+		(1 * mu2e::StrawId::_npanels + 2) * mu2e::StrawId::_nstraws + 3,
+		"TrackerLayout must number straws plane-major");
+
+} // namespace ots
+
+#endif
@@ -3,12 +3,17 @@
 #include "Offline/DataProducts/inc/TrkTypes.hh"
 #include "art/Framework/Core/ModuleMacros.h"
 #include "art_root_io/TFileService.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/DQMTimers.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/DataIntegrityMonitor.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/PedestalDriftTracker.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/StrawHealthMonitor.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerChannelLayout.h"
 #include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQMHistoContainer.h"
 #include "otsdaq/Macros/ProcessorPluginMacros.h"
 
 namespace ots {
 
-int pedestal_est(mu2e::TrkTypes::ADCWaveform adc) {
+int pedestal_est(const mu2e::TrkTypes::ADCWaveform& adc) {
   int sum{0};
 
   if (adc.size() == 0) return 0;
@@ -36,7 +41,47 @@ unsigned short max_adc(const mu2e::TrkTypes::ADCWaveform &adcs) {
 
 
 
-void summary_fill(TrackerDQMHistoContainer *histos,  const mu2e::StrawId& sid) {
+// Fill kernel of the uniformly binned histograms: the bin comes straight from
+// the booked UniformAxis (same bin as TH1::Fill) and the statistics TH1::Fill
+// would update are kept in `pending` until TrackerDQMHistoContainer::FlushPending.
+// Histograms booked with variable bins go through TH1::Fill.
+inline void uniform_fill(TrackerDQMHistoContainer::summaryInfoHist_& h, double x, double w = 1.) {
+  if (!h.axis.uniform()) {
+    h._Hist->Fill(x, w);
+    return;
+  }
+  int bin = h.axis.bin(x);
+  h._Hist->AddBinContent(bin, w);
+  if (w != 1. && h._Hist->GetSumw2N() == 0) h._Hist->Sumw2();  // as TH1::Fill does
+  if (h._Hist->GetSumw2N() > 0) h._Hist->GetSumw2()->fArray[bin] += w * w;
+  h.pending.entries += 1;
+  if (bin == 0 || bin > h.axis.n) return;  // under/overflows stay out of the stats
+  h.pending.sumw   += w;
+  h.pending.sumw2  += w * w;
+  h.pending.sumwx  += w * x;
+  h.pending.sumwx2 += w * x * x;
+}
+
+// Integer counterpart for ADC values, straw and panel numbers: the bin is a
+// table load from the booked IntegerAxis and a unit-weight fill only bumps a
+// 32-bit counter, added to the float bins by FlushPending exactly as the same
+// number of TH1::Fill calls would have. Weighted fills (sampling) and axes too
+// wide to tabulate keep the uniform_fill path.
+inline void integer_fill(TrackerDQMHistoContainer::summaryInfoHist_& h, int v, double w = 1.) {
+  if (w != 1. || !h.intAxis) {
+    uniform_fill(h, v, w);
+    return;
+  }
+  int bin = h.intAxis->bin(v);
+  ++h.counts[bin];
+  if (++h.counted.entries == UINT32_MAX) TrackerDQMHistoContainer::FlushCounts(h);
+  if (bin == 0 || bin > h.axis.n) return;
+  ++h.counted.inRange;
+  h.counted.sumx  += v;
+  h.counted.sumx2 += int64_t(v) * v;
+}
+
+void summary_fill(TrackerDQMHistoContainer *histos,  const mu2e::StrawId& sid, double weight = 1.) {
   //  __MOUT__ << "filling Summary histograms..."<< std::endl;
 
   if (histos->histograms.size() == 0) {
@@ -44,8 +89,8 @@ void summary_fill(TrackerDQMHistoContainer *histos,  const mu2e::StrawId& sid) {
              << std::endl;
   } else {
     
-    histos->histograms[0]._Hist->Fill(sid.uniquePanel());
-    histos->histograms[1]._Hist->Fill(sid.plane());
+    integer_fill(histos->histograms[0], sid.uniquePanel(), weight);
+    integer_fill(histos->histograms[1], sid.plane(), weight);
     
   }
 }
@@ -111,4 +156,340 @@ void panel_fill(TrackerDQMHistoContainer *histos, std::string  title,
   }
 }
 
+// Direct-index fills: the container must have been booked in Layout order,
+// i.e. with BookStrawHistos / BookPanelHistos
+template <class Layout = TrackerLayout>
+void straw_fill(TrackerDQMHistoContainer *histos, double data, const mu2e::StrawId& sid,
+		double weight = 1.) {
+  uniform_fill(histos->histograms[Layout::strawIndex(sid)], data, weight);
+}
+
+template <class Layout = TrackerLayout>
+void panel_index_fill(TrackerDQMHistoContainer *histos, double data, const mu2e::StrawId& sid,
+		      double weight = 1.) {
+  uniform_fill(histos->histograms[Layout::panelIndex(sid)], data, weight);
+}
+
+// integer data (ADC counts, TDC differences, straw numbers)
+template <class Layout = TrackerLayout>
+void straw_fill(TrackerDQMHistoContainer *histos, int data, const mu2e::StrawId& sid,
+		double weight = 1.) {
+  integer_fill(histos->histograms[Layout::strawIndex(sid)], data, weight);
+}
+
+template <class Layout = TrackerLayout>
+void panel_index_fill(TrackerDQMHistoContainer *histos, int data, const mu2e::StrawId& sid,
+		      double weight = 1.) {
+  integer_fill(histos->histograms[Layout::panelIndex(sid)], data, weight);
+}
+
+std::string straw_label(int channel) {
+  return std::to_string(TrackerLayout::plane(channel)) + "_" +
+	 std::to_string(TrackerLayout::panel(channel)) + "_" +
+	 std::to_string(TrackerLayout::straw(channel));
+}
+
+// One bin per listed straw, labelled plane_panel_straw
+template <class Entry, class Value>
+void channel_list_fill(TH1F *hist, const std::vector<Entry>& entries, Value value) {
+  int nBins = entries.empty() ? 1 : int(entries.size());
+  hist->Reset();
+  hist->SetBins(nBins, 0, nBins);
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    hist->GetXaxis()->SetBinLabel(i + 1, straw_label(entries[i].channel).c_str());
+    hist->SetBinContent(i + 1, value(entries[i]));
+  }
+}
+
+// Drift in ADC counts of the straws whose pedestal is drifting
+void drift_alarm_fill(TH1F *hist, const std::vector<PedestalDriftTracker::Alarm>& alarms) {
+  channel_list_fill(hist, alarms, [](const PedestalDriftTracker::Alarm& a) { return a.drift; });
+}
+
+// Hit count relative to the panel median of the flagged dead or hot straws
+void straw_health_fill(TH1F *hist, const std::vector<StrawHealthMonitor::Flag>& flags) {
+  channel_list_fill(hist, flags, [](const StrawHealthMonitor::Flag& f) { return f.ratio; });
+}
+
+// Slots of the data-integrity counter set in its container, in booking order.
+// The per-link counters come first: integrity_fill rebins them to the links
+// that sent data
+namespace IntegrityHistos {
+  enum Slot { kLinkBlocks, kLinkPackets, kLinkKBytes, kLinkEmptyBlocks, kLinkMalformedBlocks,
+	      kThroughput, kEventKBytes, kNSlots, kNLinkCounters = kThroughput };
+  enum { kNThroughputBins = 6 };  // bins of kThroughput, labelled by integrity_fill
+}
+
+// Book the data-integrity counter set, at the IntegrityHistos slots
+template <class FileService>
+void book_integrity_histos(TrackerDQMHistoContainer *histos, FileService tfs,
+			   const HistoSpecTable& specs = HistoSpecTable()) {
+  histos->BookSummaryHistos(tfs, "LinkBlocks",          1, 0, 1);
+  histos->BookSummaryHistos(tfs, "LinkPackets",         1, 0, 1);
+  histos->BookSummaryHistos(tfs, "LinkKBytes",          1, 0, 1);
+  histos->BookSummaryHistos(tfs, "LinkEmptyBlocks",     1, 0, 1);
+  histos->BookSummaryHistos(tfs, "LinkMalformedBlocks", 1, 0, 1);
+  histos->BookSummaryHistos(tfs, "Throughput",          IntegrityHistos::kNThroughputBins, 0,
+			    IntegrityHistos::kNThroughputBins);
+  histos->BookSummaryHistos(tfs, "EventKBytes",       specs[HistoSpecs::kEventKBytes]);
+}
+
+// Per-link counters get one bin per DTC/link that sent data, labelled DTC<id>_L<link>
+void integrity_fill(TrackerDQMHistoContainer *histos, const DataIntegrityMonitor& monitor) {
+  const auto& links = monitor.links();
+  int nActive = std::count_if(links.begin(), links.end(), DataIntegrityMonitor::active);
+  int nBins   = nActive == 0 ? 1 : nActive;
+  for (size_t h = 0; h < IntegrityHistos::kNLinkCounters; ++h) {
+    histos->histograms[h]._Hist->Reset();
+    histos->histograms[h]._Hist->SetBins(nBins, 0, nBins);
+  }
+
+  int bin = 0;
+  for (size_t i = 0; i < links.size(); ++i) {
+    const DataIntegrityMonitor::LinkCounters& c = links[i];
+    if (!DataIntegrityMonitor::active(c)) continue;
+    ++bin;
+    std::string label = "DTC" + std::to_string(DataIntegrityMonitor::dtc(i)) + "_L" +
+			std::to_string(DataIntegrityMonitor::link(i));
+    const double values[IntegrityHistos::kNLinkCounters] = {double(c.blocks), double(c.packets), c.bytes / 1024.,
+			      double(c.emptyBlocks), double(c.malformedBlocks)};
+    for (size_t h = 0; h < IntegrityHistos::kNLinkCounters; ++h) {
+      histos->histograms[h]._Hist->GetXaxis()->SetBinLabel(bin, label.c_str());
+      histos->histograms[h]._Hist->SetBinContent(bin, values[h]);
+    }
+  }
+
+  TH1F *throughput  = histos->histograms[IntegrityHistos::kThroughput]._Hist;
+  double window     = monitor.windowSeconds();
+  double decode     = monitor.decodeSeconds();
+  const char *labels[IntegrityHistos::kNThroughputBins] = {"events/s", "hits/s", "input MB/s", "decode MB/s", "unreadable blocks",
+			   "malformed hits"};
+  const double values[IntegrityHistos::kNThroughputBins] = {window > 0 ? monitor.events() / window : 0.,
+			    window > 0 ? monitor.hits() / window : 0.,
+			    window > 0 ? monitor.bytes() / window / 1e6 : 0.,
+			    decode > 0 ? monitor.bytes() / decode / 1e6 : 0.,
+			    double(monitor.unreadableBlocks()),
+			    double(monitor.malformedHits())};
+  throughput->Reset();
+  for (int i = 0; i < IntegrityHistos::kNThroughputBins; ++i) {
+    throughput->GetXaxis()->SetBinLabel(i + 1, labels[i]);
+    throughput->SetBinContent(i + 1, values[i]);
+  }
+}
+
+// Log-binned histogram in ns matching the LatencyHistogram binning
+template <class FileService>
+void book_latency_histo(TrackerDQMHistoContainer *histos, FileService tfs, std::string Title) {
+  double edges[LatencyHistogram::kNBins + 1];
+  for (int i = 0; i <= LatencyHistogram::kNBins; ++i) {
+    edges[i] = LatencyHistogram::lowEdge(i);
+  }
+  histos->BookSummaryHistos(tfs, Title, LatencyHistogram::kNBins, edges);
+}
+
+void latency_fill(TH1F *hist, const LatencyHistogram& latency) {
+  hist->Reset();
+  hist->SetBinContent(0, latency.underflow());
+  for (int i = 0; i < LatencyHistogram::kNBins; ++i) {
+    hist->SetBinContent(i + 1, latency.count(i));
+  }
+  hist->SetBinContent(LatencyHistogram::kNBins + 1, latency.overflow());
+  hist->SetEntries(latency.entries());
+}
+
+class TrackerHitBatch;
+
+// Everything filled for each tracker hit; a null member means "not requested"
+struct TrackerHitSinks {
+  TrackerDQMHistoContainer *summary       = nullptr;
+  TrackerDQMHistoContainer *pedestal      = nullptr;
+  TrackerDQMHistoContainer *panel         = nullptr;
+  TrackerDQMHistoContainer *tdc           = nullptr;
+  TrackerDQMHistoContainer *tdcPanel      = nullptr;
+  TrackerDQMHistoContainer *tot           = nullptr;
+  TrackerDQMHistoContainer *totPanel      = nullptr;
+  std::vector<uint16_t>    *driftChannels = nullptr;
+  std::vector<float>       *driftValues   = nullptr;
+  StrawHealthMonitor       *strawHealth   = nullptr;
+  double                    weight        = 1.;       // histogram weight of the hits (1/sampling fraction)
+  TrackerHitBatch          *batch         = nullptr;  // histogram fills deferred to TrackerHitBatch::flush
+};
+
+// Histogram fills of several events, applied histogram by histogram. Filling
+// each hit as it is decoded hops between thousands of straw histograms; the
+// batch records (histogram, value) pairs instead, radix-sorts them on the
+// histogram and fills every histogram in one sweep over its cells. The sort
+// is stable, so each histogram sees its values in decoding order and the
+// result is the same as filling them one at a time.
+class TrackerHitBatch {
+public:
+  enum Target { kSummary, kPedestal, kPanel, kTdc, kTdcPanel, kTot, kTotPanel, kNTargets };
+
+  explicit TrackerHitBatch(unsigned events) : events_(std::max(1u, events)), pending_(0), weight_(1.) {}
+
+  // the histograms of the sinks, once they are booked
+  void bind(const TrackerHitSinks& sinks) {
+    TrackerDQMHistoContainer* containers[kNTargets] = {sinks.summary, sinks.pedestal, sinks.panel,
+						       sinks.tdc, sinks.tdcPanel, sinks.tot, sinks.totPanel};
+    hists_.clear();
+    for (int t = 0; t < kNTargets; ++t) {
+      first_[t] = hists_.size();
+      if (containers[t] == nullptr) continue;
+      for (auto& h : containers[t]->histograms) hists_.push_back(&h);
+    }
+    passes_ = 1;
+    while (passes_ < 4 && (hists_.size() >> (8 * passes_)) > 0) ++passes_;
+  }
+
+  void add(Target target, int index, int value, double weight) {
+    if (weight != weight_) {  // one weight per sweep
+      flush();
+      weight_ = weight;
+    }
+    entries_.push_back({uint32_t(first_[target] + index), value});
+  }
+
+  // true when the batch holds its number of events and should be flushed
+  bool endEvent() { return ++pending_ >= events_; }
+
+  void flush() {
+    pending_ = 0;
+    if (entries_.empty()) return;
+    sort_();
+    for (size_t i = 0; i < entries_.size();) {
+      TrackerDQMHistoContainer::summaryInfoHist_& h = *hists_[entries_[i].key];
+      uint32_t key = entries_[i].key;
+      for (; i < entries_.size() && entries_[i].key == key; ++i) integer_fill(h, entries_[i].value, weight_);
+    }
+    entries_.clear();
+  }
+
+  size_t size() const { return entries_.size(); }
+
+private:
+  struct Entry {
+    uint32_t key;    // index in hists_
+    int32_t  value;
+  };
+
+  // LSD radix sort, one byte of the key per pass; the buffers are kept
+  // between flushes so that a steady run does not allocate
+  void sort_() {
+    sorted_.resize(entries_.size());
+    for (unsigned pass = 0; pass < passes_; ++pass) {
+      unsigned shift = 8 * pass;
+      size_t   offsets[257] = {0};
+      for (const Entry& e : entries_) ++offsets[((e.key >> shift) & 0xff) + 1];
+      for (int b = 0; b < 256; ++b) offsets[b + 1] += offsets[b];
+      for (const Entry& e : entries_) sorted_[offsets[(e.key >> shift) & 0xff]++] = e;
+      entries_.swap(sorted_);
+    }
+  }
+
+  unsigned events_, pending_, passes_ = 1;
+  double   weight_;
+  size_t   first_[kNTargets] = {0};
+  std::vector<TrackerDQMHistoContainer::summaryInfoHist_*> hists_;
+  std::vector<Entry> entries_, sorted_;
+};
+
+// index-th histogram of a sink container, now or at the next batch flush
+inline void deferred_fill(const TrackerHitSinks& sinks, TrackerHitBatch::Target target,
+			  TrackerDQMHistoContainer* histos, int index, int value) {
+  if (sinks.batch) sinks.batch->add(target, index, value, sinks.weight);
+  else integer_fill(histos->histograms[index], value, sinks.weight);
+}
+
+// Fill one decoded hit into the sinks; false, with nothing filled, when its
+// straw id is outside the tracker (the channel and panel index the sinks)
+template <class DataPacket>
+bool fill_tracker_hit(const TrackerHitSinks& sinks, const DataPacket& packet,
+		      const mu2e::TrkTypes::ADCWaveform& adcs) {
+  mu2e::StrawId sid(packet.StrawIndex);
+  if (!TrackerLayout::contains(sid)) return false;
+  int channel = TrackerLayout::strawIndex(sid);
+  int panel   = TrackerLayout::panelIndex(sid);
+  if (sinks.summary) {
+    if (sinks.batch) {
+      sinks.batch->add(TrackerHitBatch::kSummary, 0, sid.uniquePanel(), sinks.weight);
+      sinks.batch->add(TrackerHitBatch::kSummary, 1, sid.plane(), sinks.weight);
+    } else {
+      summary_fill(sinks.summary, sid, sinks.weight);
+    }
+  }
+  if (sinks.pedestal || sinks.driftChannels) {
+    int pedestal = pedestal_est(adcs);
+    if (sinks.pedestal) {
+      deferred_fill(sinks, TrackerHitBatch::kPedestal, sinks.pedestal, channel, pedestal);
+    }
+    if (sinks.driftChannels) {
+      sinks.driftChannels->push_back(channel);
+      sinks.driftValues->push_back(pedestal);
+    }
+  }
+  if (sinks.panel) {
+    deferred_fill(sinks, TrackerHitBatch::kPanel, sinks.panel, panel, sid.straw());
+  }
+  if (sinks.strawHealth) {
+    sinks.strawHealth->fill(channel);
+  }
+  if (sinks.tdc) {
+    int dt = int(packet.TDC0()) - int(packet.TDC1());
+    deferred_fill(sinks, TrackerHitBatch::kTdc, sinks.tdc, channel, dt);
+    deferred_fill(sinks, TrackerHitBatch::kTdcPanel, sinks.tdcPanel, panel, dt);
+  }
+  if (sinks.tot) {//both straw ends
+    deferred_fill(sinks, TrackerHitBatch::kTot, sinks.tot, channel, packet.TOT0);
+    deferred_fill(sinks, TrackerHitBatch::kTot, sinks.tot, channel, packet.TOT1);
+    deferred_fill(sinks, TrackerHitBatch::kTotPanel, sinks.totPanel, panel, packet.TOT0);
+    deferred_fill(sinks, TrackerHitBatch::kTotPanel, sinks.totPanel, panel, packet.TOT1);
+  }
+  return true;
+}
+
+// Decode every data block of a tracker fragment and fill its hits into sinks.
+// integrity and decodeTicks are optional; returns the number of hits.
+size_t fill_tracker_fragment(const mu2e::TrackerFragment& cc, const TrackerHitSinks& sinks,
+			     DataIntegrityMonitor *integrity, uint64_t *decodeTicks) {
+  size_t nHits = 0;
+  for (size_t curBlockIdx = 0; curBlockIdx < cc.block_count(); curBlockIdx++) { // iterate over straws
+    uint64_t decodeStart = decodeTicks ? DQMClock::ticks() : 0;
+    auto block_data = cc.dataAtBlockIndex(curBlockIdx);
+    if (block_data == nullptr) {
+      if (integrity) integrity->unreadableBlock();
+      mf::LogError("TrackerDQM") << "Unable to retrieve header from block "
+				 << curBlockIdx << "!" << std::endl;
+      continue;
+    }
+    auto hdr = block_data->GetHeader();
+    if (hdr->GetPacketCount() == 0) {
+      if (integrity) integrity->block(hdr->GetID(), hdr->GetLinkID(), 0, hdr->GetByteCount(), true);
+      continue;
+    }
+
+    auto trkDatas = cc.GetTrackerData(curBlockIdx);
+    if (decodeTicks) {
+      *decodeTicks += DQMClock::ticks() - decodeStart;
+    }
+    if (integrity) {
+      integrity->block(hdr->GetID(), hdr->GetLinkID(), hdr->GetPacketCount(), hdr->GetByteCount(),
+		       !trkDatas.empty());
+      integrity->addHits(trkDatas.size());
+    }
+    if (trkDatas.empty()) {
+      mf::LogError("TrackerDQM")
+	<< "Error retrieving Tracker data from DataBlock " << curBlockIdx
+	<< "!";
+      continue;
+    }
+
+    for (auto& trkData : trkDatas) {
+      if (!fill_tracker_hit(sinks, *trkData.first, trkData.second) && integrity) integrity->malformedHit();
+    }
+    nHits += trkDatas.size();
+  }
+  return nHits;
+}
+
 } // namespace ots
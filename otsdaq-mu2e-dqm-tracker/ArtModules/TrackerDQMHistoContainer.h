@@ -2,61 +2,349 @@
 #define _ProtoTypeHistos_h_
 
 #include "Offline/DataProducts/inc/StrawId.hh"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/HistoSpec.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerChannelLayout.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/BinMerge.hh"
 #include "art/Framework/Services/Registry/ServiceHandle.h"
 #include "art_root_io/TFileDirectory.h"
 #include "art_root_io/TFileService.h"
 #include "otsdaq/NetworkUtilities/TCPPublishServer.h"
 #include "otsdaq/Macros/CoutMacros.h"
 #include <TH1F.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 
 namespace ots {
 
+  // Stand-in for the TFileService outside art (benchmarks): the histograms are
+  // created on the heap and not attached to any ROOT directory
+  struct MemoryHistoDirectory {
+    MemoryHistoDirectory  mkdir(const std::string&) const { return MemoryHistoDirectory(); }
+    MemoryHistoDirectory* operator->() { return this; }
+    template <class T, class... Args>
+    T* make(Args&&... args) const {
+      T* hist = new T(std::forward<Args>(args)...);
+      hist->SetDirectory(nullptr);
+      return hist;
+    }
+  };
+
   class TrackerDQMHistoContainer {
   public:
-    TrackerDQMHistoContainer(){};
-    virtual ~TrackerDQMHistoContainer(void){};
+    TrackerDQMHistoContainer() : ownsHistos_(false) {};
+    virtual ~TrackerDQMHistoContainer(void) {
+      if (!ownsHistos_) return;  // booked histograms belong to the TFileService
+      for (auto& h : histograms) delete h._Hist;
+    };
+    // Statistics of the uniform_fill calls not yet added to the histogram
+    struct FillStats {
+      double entries = 0, sumw = 0, sumw2 = 0, sumwx = 0, sumwx2 = 0;
+    };
+
+    // Unit-weight integer_fill calls not yet added to the histogram: one
+    // counter per cell, the statistics as exact integer sums
+    struct CountStats {
+      uint32_t entries = 0, inRange = 0;
+      int64_t  sumx = 0, sumx2 = 0;
+    };
+
     struct summaryInfoHist_ {
-      TH1F *_Hist;
-      int   plane;
-      int   panel;
-      int   straw;
+      TH1F        *_Hist;
+      int          plane;
+      int          panel;
+      int          straw;
+      UniformAxis  axis;     // binning of _Hist when it is uniform
+      FillStats    pending;
+      std::shared_ptr<const IntegerAxis> intAxis;  // null: no integer fast path
+      std::vector<uint32_t> counts;
+      CountStats   counted;
       summaryInfoHist_() { _Hist = NULL; }
     };
 
     std::vector<summaryInfoHist_> histograms;
 
-    void BookSummaryHistos(art::ServiceHandle<art::TFileService> tfs, std::string Title,
+    template <class FileService>
+    void BookSummaryHistos(FileService tfs, std::string Title,
 			   int nBins, float min, float max) {
       histograms.push_back(summaryInfoHist_());
-      art::TFileDirectory testDir = tfs->mkdir("Tracker_summary");
+      auto                testDir = tfs->mkdir("Tracker_summary");
       this->histograms[histograms.size() - 1]._Hist = 
-	testDir.make<TH1F>(Title.c_str(), Title.c_str(), nBins, min, max);
+	testDir.template make<TH1F>(Title.c_str(), Title.c_str(), nBins, min, max);
+      this->histograms[histograms.size() - 1].axis = UniformAxis(nBins, min, max);
+      AttachIntegerAxis(histograms.back());
+    }
+
+    template <class FileService>
+    void BookSummaryHistos(FileService tfs, std::string Title, const HistoSpec& spec) {
+      BookSummaryHistos(tfs, Title, spec.x.n, spec.x.min, spec.x.max);
+    }
+  
+    template <class FileService>
+    void BookSummaryHistos(FileService tfs, std::string Title,
+			   int nBins, const double* edges) {
+      histograms.push_back(summaryInfoHist_());
+      auto                testDir = tfs->mkdir("Tracker_summary");
+      this->histograms[histograms.size() - 1]._Hist = 
+	testDir.template make<TH1F>(Title.c_str(), Title.c_str(), nBins, edges);
     }
   
-    void BookHistos(art::ServiceHandle<art::TFileService> tfs, std::string Title,
+    template <class FileService>
+    void BookHistos(FileService tfs, std::string Title,
 		    int plane, int panel, int straw) {
+      if(straw>=0){//histograms are straw-specific, aka pedestals
+	BookHistos(tfs, Title, plane, panel, straw, 200, 0., 500.);
+      }else {
+	BookHistos(tfs, Title, plane, panel, straw, 100, 0., 100.);
+      }
+    }
+
+    template <class FileService>
+    void BookHistos(FileService tfs, std::string Title,
+		    int plane, int panel, int straw, int nBins, float hMin, float hMax) {
       histograms.push_back(summaryInfoHist_());
       std::string         dirName = "plane_"+std::to_string(plane);
-      int                 nBins(100);
-      float               hMin(0), hMax(100);
-      art::TFileDirectory testDir = tfs->mkdir(dirName);
+      auto                testDir = tfs->mkdir(dirName);
 
-      if(straw>=0){//histograms are straw-specific, aka pedestals
-	std::string subDirN = "panel_"  +std::to_string(panel);
-	dirName  += "/"+subDirN;
-	art::TFileDirectory subDir  = testDir.mkdir(subDirN);
-	nBins    = 200;
-	hMax     = 500.;
-      }
-    
       this->histograms[histograms.size() - 1]._Hist =
-	testDir.make<TH1F>(Title.c_str(), Title.c_str(), nBins, hMin, hMax);
+	testDir.template make<TH1F>(Title.c_str(), Title.c_str(), nBins, hMin, hMax);
       this->histograms[histograms.size() - 1].plane = plane;
       this->histograms[histograms.size() - 1].panel = panel;
       this->histograms[histograms.size() - 1].straw = straw;
+      this->histograms[histograms.size() - 1].axis  = UniformAxis(nBins, hMin, hMax);
+      AttachIntegerAxis(histograms.back());
+    }
+
+    // Book one histogram per straw (per panel) in Layout order, so that
+    // histograms[Layout::strawIndex(sid)] (histograms[Layout::panelIndex(sid)]) is the one of sid
+    template <class Layout = TrackerLayout, class FileService>
+    void BookStrawHistos(FileService tfs, std::string Prefix,
+			 int nBins, float hMin, float hMax) {
+      histograms.reserve(histograms.size() + Layout::kNChannels);
+      for (int plane = 0; plane < Layout::kPlanes; plane++) {
+	for (int panel = 0; panel < Layout::kPanels; panel++) {
+	  for (int straw = 0; straw < Layout::kStraws; straw++) {
+	    BookHistos(tfs, Prefix + "_" + std::to_string(plane) + "_" + std::to_string(panel) + "_" +
+		       std::to_string(straw), plane, panel, straw, nBins, hMin, hMax);
+	  }
+	}
+      }
+    }
+
+    template <class Layout = TrackerLayout, class FileService>
+    void BookStrawHistos(FileService tfs, std::string Prefix, const HistoSpec& spec) {
+      BookStrawHistos<Layout>(tfs, Prefix, spec.x.n, spec.x.min, spec.x.max);
+    }
+
+    template <class Layout = TrackerLayout, class FileService>
+    void BookPanelHistos(FileService tfs, std::string Prefix,
+			 int nBins, float hMin, float hMax) {
+      histograms.reserve(histograms.size() + Layout::kNPanels);
+      for (int plane = 0; plane < Layout::kPlanes; plane++) {
+	for (int panel = 0; panel < Layout::kPanels; panel++) {
+	  BookHistos(tfs, Prefix + "_" + std::to_string(plane) + "_" + std::to_string(panel),
+		     plane, panel, -1, nBins, hMin, hMax);
+	}
+      }
+    }
+
+    template <class Layout = TrackerLayout, class FileService>
+    void BookPanelHistos(FileService tfs, std::string Prefix, const HistoSpec& spec) {
+      BookPanelHistos<Layout>(tfs, Prefix, spec.x.n, spec.x.min, spec.x.max);
+    }
+
+    // Add what uniform_fill and integer_fill kept aside to the histograms,
+    // before they are read (cloned, exported, written)
+    void FlushPending() {
+      for (auto& h : histograms) {
+	FlushCounts(h);
+	if (h.pending.entries == 0) continue;
+	double stats[4];
+	StoredStats(h._Hist, stats);
+	stats[0] += h.pending.sumw;
+	stats[1] += h.pending.sumw2;
+	stats[2] += h.pending.sumwx;
+	stats[3] += h.pending.sumwx2;
+	h._Hist->PutStats(stats);
+	h._Hist->SetEntries(h._Hist->GetEntries() + h.pending.entries);
+	h.pending = FillStats();
+      }
+    }
+
+    // The counters go into the float cells as `count` successive += 1 would:
+    // exact below 2^24, where a float bin filled one by one stops growing.
+    // Their statistics join the uniform_fill ones; the sums are integers, so
+    // adding them at once gives the doubles TH1::Fill would have accumulated.
+    static void FlushCounts(summaryInfoHist_& h) {
+      if (h.counted.entries == 0) return;
+      float*  cells = h._Hist->fArray;
+      double* sumw2 = h._Hist->GetSumw2N() > 0 ? h._Hist->GetSumw2()->fArray : nullptr;
+      for (size_t bin = 0; bin < h.counts.size(); ++bin) {
+	uint32_t count = h.counts[bin];
+	if (count == 0) continue;
+	cells[bin] = AddOnes(cells[bin], count);
+	if (sumw2) sumw2[bin] = AddOnes(sumw2[bin], count);
+	h.counts[bin] = 0;
+      }
+      h.pending.entries += h.counted.entries;
+      h.pending.sumw    += h.counted.inRange;
+      h.pending.sumw2   += h.counted.inRange;
+      h.pending.sumwx   += double(h.counted.sumx);
+      h.pending.sumwx2  += double(h.counted.sumx2);
+      h.counted = CountStats();
+    }
+
+    // The sums the histogram keeps, as TH1::Fill accumulated them. With
+    // entries but no weight in range (only under/overflows so far),
+    // TH1::GetStats would instead recompute them from the bins, which already
+    // hold the pending fills, and these would then be counted twice.
+    static void StoredStats(TH1F* hist, double stats[4]) {
+      double entries = hist->GetEntries();
+      hist->SetEntries(0);
+      hist->GetStats(stats);
+      hist->SetEntries(entries);
+    }
+
+    // value after `count` times value += 1 in type F
+    template <class F>
+    static F AddOnes(F value, uint64_t count) {
+      const double limit = double(uint64_t(1) << std::numeric_limits<F>::digits);
+      if (value == F(int64_t(value)) && std::abs(double(value)) < limit) {
+	double sum = double(value) + double(count);
+	return F(sum < limit ? sum : limit);  // integers up to 2^digits are exact, then x + 1 == x
+      }
+      for (uint64_t i = 0; i < count; ++i) {
+	F next = value + F(1);
+	if (next == value) break;
+	value = next;
+      }
+      return value;
+    }
+
+    // Empty histogram i and what is kept aside for it: a memset of the bins
+    // (and sumw2) and zero statistics, all a DQM reset needs. TH1::Reset also
+    // goes through the function list, integral and buffer of each histogram.
+    void Clear(size_t i) {
+      summaryInfoHist_& h = histograms[i];
+      ClearHist(h._Hist);
+      std::fill(h.counts.begin(), h.counts.end(), 0);
+      h.counted = CountStats();
+      h.pending = FillStats();
+    }
+
+    void Clear() {
+      for (size_t i = 0; i < histograms.size(); ++i) Clear(i);
+    }
+
+    static void ClearHist(TH1F* hist) {
+      std::memset(hist->fArray, 0, hist->GetNcells() * sizeof(float));
+      if (hist->GetSumw2N() > 0) std::memset(hist->GetSumw2()->fArray, 0, hist->GetSumw2N() * sizeof(double));
+      double stats[4] = {0., 0., 0., 0.};
+      hist->PutStats(stats);
+      hist->SetEntries(0);
+    }
+
+    // Overwrite a histogram of the same binning with the bins, sumw2 and
+    // statistics of another; no allocation once both have their sumw2
+    static void CopyHist(TH1F* from, TH1F* to) {
+      std::memcpy(to->fArray, from->fArray, from->GetNcells() * sizeof(float));
+      if (from->GetSumw2N() > 0) {
+	if (to->GetSumw2N() == 0) to->Sumw2();
+	std::memcpy(to->GetSumw2()->fArray, from->GetSumw2()->fArray, from->GetSumw2N() * sizeof(double));
+      } else if (to->GetSumw2N() > 0) {
+	to->Sumw2(false);
+      }
+      double stats[4];
+      StoredStats(from, stats);
+      to->PutStats(stats);
+      to->SetEntries(from->GetEntries());
+    }
+
+    // Private copy for one filling thread: the same histograms and binning,
+    // empty, owned by the replica and attached to no directory. A thread fills
+    // its replica without any lock shared with the other threads; the owner
+    // of this container folds it in with MergeReplica while it is not filled.
+    TrackerDQMHistoContainer* MakeReplica() const {
+      TrackerDQMHistoContainer* replica = new TrackerDQMHistoContainer(*this);
+      replica->ownsHistos_ = true;
+      for (auto& h : replica->histograms) {
+	h._Hist = new TH1F(*h._Hist);
+	h._Hist->SetDirectory(nullptr);
+	h._Hist->Reset();
+	std::fill(h.counts.begin(), h.counts.end(), 0);
+	h.counted = CountStats();
+	h.pending = FillStats();
+      }
+      return replica;
+    }
+
+    // Add a replica of this container and clear it. Integer counters are
+    // summed exactly, so unit-weight fills give the same histograms as one
+    // thread filling everything; weighted fills are float additions, in
+    // merge order.
+    void MergeReplica(TrackerDQMHistoContainer& replica) {
+      for (size_t i = 0; i < histograms.size(); ++i) {
+	summaryInfoHist_& h = histograms[i];
+	summaryInfoHist_& r = replica.histograms[i];
+	if (r.counted.entries > 0) {
+	  if (h.counted.entries > UINT32_MAX - r.counted.entries) FlushCounts(h);
+	  detail::move_bins(h.counts.data(), r.counts.data(), h.counts.size());
+	  h.counted.entries += r.counted.entries;
+	  h.counted.inRange += r.counted.inRange;
+	  h.counted.sumx    += r.counted.sumx;
+	  h.counted.sumx2   += r.counted.sumx2;
+	  r.counted = CountStats();
+	}
+	// weighted fills and variable bins went to the replica histogram itself
+	if (r.pending.entries == 0 && r._Hist->GetEntries() == 0) continue;
+	int cells = h._Hist->GetNcells();
+	detail::add_bins(h._Hist->fArray, r._Hist->fArray, cells);
+	if (r._Hist->GetSumw2N() > 0) {
+	  if (h._Hist->GetSumw2N() == 0) h._Hist->Sumw2();
+	  detail::add_bins(h._Hist->GetSumw2()->fArray, r._Hist->GetSumw2()->fArray, cells);
+	}
+	if (r._Hist->GetEntries() > 0) {
+	  double stats[4], more[4];
+	  StoredStats(h._Hist, stats);
+	  StoredStats(r._Hist, more);
+	  for (int k = 0; k < 4; ++k) stats[k] += more[k];
+	  h._Hist->PutStats(stats);
+	  h._Hist->SetEntries(h._Hist->GetEntries() + r._Hist->GetEntries());
+	}
+	h.pending.entries += r.pending.entries;
+	h.pending.sumw    += r.pending.sumw;
+	h.pending.sumw2   += r.pending.sumw2;
+	h.pending.sumwx   += r.pending.sumwx;
+	h.pending.sumwx2  += r.pending.sumwx2;
+	r.pending = FillStats();
+	ClearHist(r._Hist);
+      }
+    }
+
+  private:
+    // integer fast path for the uniform axes small enough to tabulate; the
+    // straws of a container share their table
+    void AttachIntegerAxis(summaryInfoHist_& h) {
+      if (!IntegerAxis::suitable(h.axis)) return;
+      for (const auto& a : intAxes_) {
+	if (a->axis().n == h.axis.n && a->axis().min == h.axis.min && a->axis().max == h.axis.max) {
+	  h.intAxis = a;
+	  break;
+	}
+      }
+      if (!h.intAxis) {
+	intAxes_.push_back(std::make_shared<const IntegerAxis>(h.axis));
+	h.intAxis = intAxes_.back();
+      }
+      h.counts.assign(h.axis.n + 2, 0);
     }
 
+    std::vector<std::shared_ptr<const IntegerAxis>> intAxes_;
+    bool ownsHistos_;
   };
 
 } // namespace ots
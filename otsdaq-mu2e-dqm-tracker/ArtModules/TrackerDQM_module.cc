@@ -5,13 +5,29 @@
 #include "art/Framework/Core/ModuleMacros.h"
 #include "art/Framework/Principal/Event.h"
 #include "art/Framework/Principal/Handle.h"
+#include "art/Framework/Principal/Run.h"
+#include "art/Framework/Principal/SubRun.h"
 #include "art_root_io/TFileService.h"
 #include "fhiclcpp/types/OptionalAtom.h"
+#include "fhiclcpp/types/OptionalDelegatedParameter.h"
+#include "fhiclcpp/types/OptionalSequence.h"
+#include "fhiclcpp/types/Tuple.h"
 #include <TBufferFile.h>
 #include <TH1F.h>
+#include <TROOT.h>
 
 #include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQMHistoContainer.h"
 #include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQM.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/FragmentRing.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/FrameCompressor.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/AdaptiveSampler.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/BinaryHisto.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/HistoArena.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/PublishScheduler.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/PublishStamp.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/SharedHistoExport.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/DataRequestServer.hh"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/SubscriptionServer.hh"
 #include "otsdaq/Macros/CoutMacros.h"
 #include "otsdaq/Macros/ProcessorPluginMacros.h"
 #include "otsdaq/MessageFacility/MessageFacility.h"
@@ -28,6 +44,15 @@
 #include "Offline/DataProducts/inc/StrawId.hh"
 #include "Offline/DataProducts/inc/TrkTypes.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 namespace ots {
   class TrackerDQM : public art::EDAnalyzer {
   public:
@@ -40,6 +65,38 @@ namespace ots {
       fhicl::Sequence<std::string> histType  { Name("histType"),  Comment("This parameter determines which quantity is histogrammed") };
       fhicl::Atom<int>             freqDQM   { Name("freqDQM"),   Comment("Frequency for sending histograms to the data-receiver") };
       fhicl::Atom<int>             diag      { Name("diagLevel"), Comment("Diagnostic level"), 0 };
+      fhicl::Atom<float>           driftAlpha     { Name("pedestalDriftAlpha"),     Comment("Weight of a new hit in the exponentially weighted pedestal mean"), 0.01 };
+      fhicl::Atom<float>           driftThreshold { Name("pedestalDriftThreshold"), Comment("Pedestal drift, in ADC counts, above which a straw is reported"), 5. };
+      fhicl::Atom<int>             driftWarmup    { Name("pedestalDriftWarmup"),    Comment("Number of hits after which the reference pedestal of a straw is frozen"), 200 };
+      fhicl::Atom<int>             healthPeriod   { Name("strawHealthPeriod"),      Comment("Number of events between two dead/hot straw checks"), 1000 };
+      fhicl::Atom<float>           deadSigma      { Name("deadStrawSigma"),         Comment("Significance below the panel median for a straw to be flagged dead"), 5. };
+      fhicl::Atom<float>           hotSigma       { Name("hotStrawSigma"),          Comment("Significance above the panel median for a straw to be flagged hot"), 5. };
+      fhicl::Atom<float>           minMedian      { Name("strawHealthMinMedian"),   Comment("Minimum panel median count for the panel to be checked"), 10. };
+      fhicl::Atom<std::string>     wireFormat     { Name("wireFormat"),             Comment("Histogram encoding sent to address:port: root (HistoSender, TBufferFile) or binary (BinaryHisto frames)"), "root" };
+      fhicl::Atom<std::string>     compression    { Name("compression"),            Comment("Compression of the binary frames: none, lz4, zstd or auto (by frame size); lz4/zstd need the build to find them"), "none" };
+      fhicl::Atom<int>             compressionLevel { Name("compressionLevel"),     Comment("Zstd level"), 3 };
+      fhicl::Atom<unsigned>        compressionMinBytes { Name("compressionMinBytes"), Comment("Frames smaller than this are sent uncompressed"), 4096 };
+      fhicl::Atom<unsigned>        compressionZstdBytes { Name("compressionZstdBytes"), Comment("With compression auto: LZ4 below this frame size, Zstd above"), 1u << 20 };
+      fhicl::Atom<std::string>     sharedMemory   { Name("sharedMemory"),           Comment("POSIX shared-memory name (e.g. /trackerDQM) where every publish also leaves the bin arrays for consumers on this node; empty: no export"), "" };
+      fhicl::Atom<bool>            publishStamp   { Name("publishStamp"),           Comment("Send a sequence number and send time with each publish, for tools/histo_loopback_receiver"), false };
+      fhicl::Atom<int>             requestPort    { Name("requestPort"),            Comment("Port answering DataRequestMessage queries for the raw tracker data of recent events, 0 to disable"), 0 };
+      fhicl::Atom<int>             requestBufferSize { Name("requestBufferSize"),   Comment("Number of recent events kept for DataRequestMessage queries"), 100 };
+      fhicl::Atom<int>             dqmWorkers     { Name("dqmWorkers"),             Comment("Threads decoding and histogramming events handed off by analyze, each into its own copy of the histograms merged at publish; 0 to process them inline"), 0 };
+      fhicl::Atom<int>             dqmQueueSize   { Name("dqmQueueSize"),           Comment("Number of events queued between analyze and the DQM threads"), 64 };
+      fhicl::Atom<std::string>     overloadPolicy { Name("overloadPolicy"),         Comment("When the DQM queue is full: block (wait for the DQM threads) or sample (skip the event)"), "block" };
+      fhicl::Atom<float>           cpuBudget      { Name("cpuBudget"),              Comment("Cores the event processing may use; events are sampled to stay within it, 0 to analyze every event"), 0. };
+      fhicl::Atom<float>           samplingAlpha  { Name("samplingAlpha"),          Comment("Weight of the last event in the averaged DQM cost and input rate"), 0.05 };
+      fhicl::Atom<float>           minSampling    { Name("minSamplingFraction"),    Comment("Smallest fraction of events analyzed when sampling"), 0.001 };
+      fhicl::Atom<float>           publishInterval{ Name("publishInterval"),        Comment("Seconds between two publishes of the histograms, 0 to publish every freqDQM events"), 0. };
+      fhicl::OptionalSequence<fhicl::Tuple<std::string,float>> groupIntervals { Name("publishGroupIntervals"),
+	  Comment("Per-group publish intervals in seconds, overriding publishInterval, e.g. [[\"pedestals\", 30.], [\"summary\", 1.]]. "
+		  "Groups: summary, pedestals, panels, tdc, tot, pedestalDrift, strawHealth, integrity, latency, sampling") };
+      fhicl::Atom<int>             detailPort     { Name("detailPort"),             Comment("Port taking subscriptions to the per-straw histograms (pedestals, tdc, tot), which are then only sent for the subscribed panels; 0 sends them all"), 0 };
+      fhicl::Atom<float>           detailTTL      { Name("detailTTL"),              Comment("Seconds a per-straw subscription lasts unless renewed"), 60. };
+      fhicl::Atom<unsigned>        fillBatchEvents{ Name("fillBatchEvents"),        Comment("Events whose hits are collected, then filled histogram by histogram; 1 fills each hit as it is decoded"), 1 };
+      fhicl::Atom<std::string>     resetOn        { Name("resetOn"),                Comment("Transition at which every histogram and monitor starts over: job (never), run or subrun"), "run" };
+      fhicl::Atom<bool>            subRunTotals   { Name("subRunTotals"),           Comment("Keep the summary and per-panel histograms of each subrun, across publishes, and write them under run_R/subrun_S at its end"), false };
+      fhicl::OptionalDelegatedParameter histoBinning { Name("histoBinning"),    Comment("Binning overrides, name: [nBins, min, max] (2D: [nBins, min, max, nBinsY, minY, maxY]); names and defaults in HistoSpec.h") };
     };
 
     typedef art::EDAnalyzer::Table<Config> Parameters;
@@ -48,6 +105,8 @@ namespace ots {
 
     void analyze(art::Event const& event) override;
     void beginRun(art::Run const&) override;
+    void endSubRun(art::SubRun const&) override;
+    void endRun(art::Run const&) override;
     void beginJob() override;
     void endJob() override;
 
@@ -64,20 +123,208 @@ namespace ots {
     TrackerDQMHistoContainer* pedestal_histos = new TrackerDQMHistoContainer();
     TrackerDQMHistoContainer* panel_histos    = new TrackerDQMHistoContainer();
     TrackerDQMHistoContainer* summary_histos  = new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* drift_histos    = new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* health_histos   = new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* tdc_histos      = new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* tdc_panel_histos= new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* tot_histos      = new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* tot_panel_histos= new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* integrity_histos= new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* latency_histos  = new TrackerDQMHistoContainer();
+    TrackerDQMHistoContainer* sampling_histos = new TrackerDQMHistoContainer();
+    DataIntegrityMonitor      integrity_;
+    PedestalDriftTracker      pedestalDrift_;
+    StrawHealthMonitor        strawHealth_;
+    enum { kEventLatency, kDecodeLatency, kFillLatency, kPublishLatency, kHitLatency, kNLatencies };
+    LatencyHistogram          latency_[kNLatencies];
+    HistoSpecTable            histoSpecs_;
+    //what one thread fills event by event: the shared histograms and monitors
+    //when events are processed inline, private replicas of them for each DQM
+    //thread, folded into the shared ones by merge_replicas_
+    struct FillState {
+      std::mutex              mutex;          //held while the replicas are filled or merged
+      bool                    replica = false;
+      TrackerHitSinks         sinks;
+      std::vector<std::pair<TrackerDQMHistoContainer*,TrackerDQMHistoContainer*>> histos;  //shared, replica
+      DataIntegrityMonitor*   integrity = nullptr;
+      std::vector<uint16_t>   driftChannels;
+      std::vector<float>      driftValues;
+      uint64_t                decodeTicks = 0, hits = 0;
+    };
+    FillState                 inline_;
+    std::vector<FillState*>   replicas_;
+    std::atomic<uint64_t>     queued_, processed_;  //events handed to the DQM threads, and done
+    enum { kResetJob, kResetRun, kResetSubRun } resetOn_;
+    //totals of the subrun being taken, and those of the last one while they are written
+    HistoArena*               totals_;
+    HistoArena*               spareTotals_;
+    std::vector<std::pair<TrackerDQMHistoContainer*,std::string>> totalsGroups_;
     HistoSender*              histSender_;
-    bool                      doPedestalHist_, doPanelHist_;
+    TCPSendClient*            binarySender_;
+    bool                      binaryConnected_;
+    BinaryHisto::Writer       binaryWriter_;
+    FrameCompressor           compressor_;
+    SharedHisto::Writer*      sharedExport_;
+    std::unique_ptr<TH1D>     publishStamp_;
+    uint64_t                  publishCount_;
+    DataRequestServer*        requestServer_;
+    std::vector<DataRequestServer::Block> requestBlocks_;
+    struct PendingEvent {
+      uint64_t                              number;
+      double                                weight;  // 1/sampling fraction when the event was accepted
+      std::vector<DataRequestServer::Block> blocks;
+    };
+    PendingEvent              pending_;
+    FragmentRing<PendingEvent>* queue_;
+    std::vector<std::thread>  workers_;
+    std::mutex                fillMutex_;
+    std::atomic<bool>         stopWorkers_;
+    bool                      sampleOnOverload_;
+    uint64_t                  droppedEvents_;
+    AdaptiveSampler           sampler_;
+    enum { kSummaryGroup, kPedestalGroup, kPanelGroup, kTdcGroup, kTotGroup, kPedestalDriftGroup,
+	   kStrawHealthGroup, kIntegrityGroup, kLatencyGroup, kSamplingGroup, kNGroups };
+    static const char*        groupNames_[kNGroups];
+    PublishScheduler          scheduler_;
+    std::thread               publisher_;
+    std::atomic<bool>         stopPublisher_;
+    enum { kPedestalDetail, kTdcDetail, kTotDetail, kNDetails };
+    SubscriptionServer*       subscriptions_;
+    std::vector<bool>         detailPanels_;
+    const std::vector<bool>*  detail_panels_(int detail);
+    bool                      doPedestalHist_, doPanelHist_, doPedestalDrift_, doStrawHealth_;
+    bool                      doTdcHist_, doTotHist_, doIntegrity_, doLatency_;
     std::string               moduleTag;
-    void analyze_tracker_(const mu2e::TrackerFragment& cc);
+    void analyze_tracker_(const mu2e::TrackerFragment& cc, FillState& st);
+    void process_event_(const PendingEvent& ev, FillState& st);
+    FillState* make_replica_();
+    void merge_replicas_(bool histos);
+    void worker_(FillState* st);
+    void publisher_loop_();
+    void publish_(PublishScheduler::GroupMask groups);
+    void send_binary_(const std::map<std::string,std::vector<TH1*>>& hists_to_send);
+    std::string group_path_(const std::string& name, const TrackerDQMHistoContainer::summaryInfoHist_& hist) const;
+    void share_(TrackerDQMHistoContainer* histos, const std::string& name, bool perPlane, size_t first = 0);
+    void book_groups_(TrackerDQMHistoContainer* histos, const std::string& name, bool perPlane, bool rebinned = false);
+    void send_(TrackerDQMHistoContainer* histos, size_t i, bool clear);
+    void flush_stats_();
+    void clear_(TrackerDQMHistoContainer* histos, size_t i);
+    void drain_();
+    void reset_state_();
+    void write_totals_(const HistoArena& totals, art::RunNumber_t run, art::SubRunNumber_t subRun);
+    void collect_(TrackerDQMHistoContainer* histos, const std::string& name,
+		  const std::vector<bool>* panels = nullptr);
+    //what publish_ sends, laid out at booking: one entry per group path, its
+    //vector sized for the group, and for each histogram its vector and a
+    //detached copy. A publish refreshes the copies in place, sends them, then
+    //clears what was sent, without building any key, map node or TH1.
+    //Ownership: the module owns the snapshots (and the publish stamp) for
+    //the whole job; HistoSender::sendHistograms and send_binary_ only
+    //serialize the const map, and neither keep nor delete what it points to.
+    //The senders never see the TFileService histograms
+    struct PublishSlot {
+      std::vector<TH1*>*    group;
+      std::unique_ptr<TH1F> snapshot;
+      bool                  rebinned;  //SetBins or labels at publish: copied whole
+    };
+    std::map<std::string,std::vector<TH1*>> hists_to_send_;
+    std::map<std::string,std::vector<TH1*>> idleGroups_;  //entries with nothing to send this time
+    std::map<const TrackerDQMHistoContainer*,std::vector<PublishSlot>> publishGroups_;
+    std::vector<TH1*>*        stampGroup_;
+    std::vector<std::pair<TrackerDQMHistoContainer*,size_t>> sent_;  //to clear once sent
     
   };
 } // namespace ots
 
+const char* ots::TrackerDQM::groupNames_[kNGroups] = {
+  "summary", "pedestals", "panels", "tdc", "tot", "pedestalDrift", "strawHealth", "integrity", "latency", "sampling"
+};
+
 ots::TrackerDQM::TrackerDQM(Parameters const& conf)
   : art::EDAnalyzer(conf), conf_(conf()), port_(conf().port()), address_(conf().address()),
     moduleTag_(conf().moduleTag()), histType_(conf().histType()), 
     freqDQM_(conf().freqDQM()), diagLevel_(conf().diag()), evtCounter_(0), 
-    doPedestalHist_(false), doPanelHist_(false) {
-  histSender_  = new HistoSender(address_, port_);
+    pedestalDrift_(TrackerLayout::kNChannels, conf().driftAlpha(), conf().driftThreshold(), conf().driftWarmup()),
+    strawHealth_(TrackerLayout::kNChannels, TrackerLayout::kStraws, conf().healthPeriod(),
+		 conf().deadSigma(), conf().hotSigma(), conf().minMedian()),
+    queued_(0), processed_(0), resetOn_(kResetRun), totals_(nullptr), spareTotals_(nullptr),
+    binarySender_(nullptr), binaryConnected_(false),
+    compressor_(conf().compression(), conf().compressionLevel(), conf().compressionMinBytes(),
+		conf().compressionZstdBytes()),
+    sharedExport_(nullptr), publishCount_(0),
+    requestServer_(nullptr), queue_(nullptr), stopWorkers_(false),
+    sampleOnOverload_(conf().overloadPolicy() == "sample"), droppedEvents_(0),
+    sampler_(conf().cpuBudget(), conf().samplingAlpha(), conf().minSampling()),
+    scheduler_(kNGroups), stopPublisher_(false), subscriptions_(nullptr),
+    doPedestalHist_(false), doPanelHist_(false), doPedestalDrift_(false), doStrawHealth_(false),
+    doTdcHist_(false), doTotHist_(false), doIntegrity_(false), doLatency_(false), stampGroup_(nullptr) {
+  if (conf().wireFormat() == "binary") {
+    histSender_   = nullptr;
+    binarySender_ = new TCPSendClient(address_, port_);
+  } else {
+    if (conf().wireFormat() != "root") {
+      __MOUT_ERR__ << "Unrecognized wireFormat: " << conf().wireFormat() << ", using root" << std::endl;
+    }
+    histSender_ = new HistoSender(address_, port_);
+  }
+  if (!compressor_.ok()) {
+    __MOUT_ERR__ << "compression " << conf().compression() << " is unknown or not built in, frames go uncompressed" << std::endl;
+  }
+  if (compressor_.enabled() && !binarySender_) {
+    __MOUT_ERR__ << "compression applies to wireFormat binary only, HistoSender frames go uncompressed" << std::endl;
+  }
+  if (conf().publishStamp()) publishStamp_ = PublishStamp::book(moduleTag_);
+  if (conf().requestPort() > 0 && conf().requestBufferSize() > 0) {
+    requestServer_ = new DataRequestServer(conf().requestPort(), conf().requestBufferSize());
+    if (!requestServer_->start()) {
+      __MOUT_ERR__ << "[TrackerDQM] data requests disabled" << std::endl;
+      delete requestServer_;
+      requestServer_ = nullptr;
+    }
+  }
+  if (conf().detailPort() > 0) {
+    subscriptions_ = new SubscriptionServer(conf().detailPort(), {"pedestals", "tdc", "tot"},
+					    TrackerLayout::kPlanes, TrackerLayout::kPanels, conf().detailTTL());
+    if (!subscriptions_->start()) {
+      __MOUT_ERR__ << "[TrackerDQM] per-straw subscriptions disabled, sending every straw" << std::endl;
+      delete subscriptions_;
+      subscriptions_ = nullptr;
+    }
+  }
+
+  fhicl::ParameterSet binning;
+  if (conf().histoBinning.get_if_present(binning)) {
+    for (const std::string& error : histoSpecs_.load(binning)) {
+      __MOUT_ERR__ << "histoBinning: " << error << ", keeping the default" << std::endl;
+    }
+  }
+
+  for (int group = 0; group < kNGroups; group++) {
+    scheduler_.setInterval(group, conf().publishInterval());
+  }
+  std::vector<std::tuple<std::string,float>> groupIntervals;
+  if (conf().groupIntervals(groupIntervals)) {
+    for (const auto& entry : groupIntervals) {
+      auto name = std::find(groupNames_, groupNames_ + kNGroups, std::get<0>(entry));
+      if (name == groupNames_ + kNGroups) {
+	__MOUT_ERR__ << "Unrecognized publish group: " << std::get<0>(entry) << std::endl;
+	continue;
+      }
+      scheduler_.setInterval(name - groupNames_, std::get<1>(entry));
+    }
+  }
+
+  if (conf().resetOn() == "job") {
+    resetOn_ = kResetJob;
+  } else if (conf().resetOn() == "subrun") {
+    resetOn_ = kResetSubRun;
+  } else if (conf().resetOn() != "run") {
+    __MOUT_ERR__ << "Unrecognized resetOn: " << conf().resetOn() << ", using run" << std::endl;
+  }
+
+  if (conf().overloadPolicy() != "block" && conf().overloadPolicy() != "sample") {
+    __MOUT_ERR__ << "Unrecognized overloadPolicy: " << conf().overloadPolicy() << ", using block" << std::endl;
+  }
   
   if (diagLevel_>0){
     __MOUT__ << "[TrackerDQM::analyze] DQM for "<< histType_[0] << std::endl;
@@ -87,46 +334,199 @@ ots::TrackerDQM::TrackerDQM(Parameters const& conf)
     if (name == "pedestals") {
       doPedestalHist_ = true;
     }
-    if (name == "panels") {
+    else if (name == "panels") {
       doPanelHist_ = true;
     }
+    else if (name == "pedestalDrift") {
+      doPedestalDrift_ = true;
+    }
+    else if (name == "strawHealth") {
+      doStrawHealth_ = true;
+    }
+    else if (name == "tdc") {
+      doTdcHist_ = true;
+    }
+    else if (name == "tot") {
+      doTotHist_ = true;
+    }
+    else if (name == "integrity") {
+      doIntegrity_ = true;
+    }
+    else if (name == "latency") {
+      doLatency_ = true;
+    }
+    else {
+      __MOUT_ERR__ << "Unrecognized histogram type: " << name << std::endl;
+    }
   }
 }
 
 void ots::TrackerDQM::beginJob() {
   __MOUT__ << "[TrackerDQM::beginJob] Beginning job" << std::endl;
   summary_histos->BookSummaryHistos(tfs,
-				    "PanelOccupancy", 220, 0, 220);
+				    "PanelOccupancy", histoSpecs_[HistoSpecs::kPanelOccupancy]);
   summary_histos->BookSummaryHistos(tfs,
-				    "PlaneOccupancy", 40, 0, 40);
+				    "PlaneOccupancy", histoSpecs_[HistoSpecs::kPlaneOccupancy]);
+
+  if (doPedestalDrift_){
+    drift_histos->BookSummaryHistos(tfs, "PedestalDriftAlarms", 1, 0, 1);
+  }
+
+  if (doStrawHealth_){
+    health_histos->BookSummaryHistos(tfs, "DeadStraws", 1, 0, 1);
+    health_histos->BookSummaryHistos(tfs, "HotStraws", 1, 0, 1);
+  }
 			     
   if (doPedestalHist_){
-    for (int plane = 0; plane <  mu2e::StrawId::_nplanes; plane++) {
-      for (int panel = 0; panel < mu2e::StrawId::_npanels; panel++) {
-	for (int straw = 0; straw < mu2e::StrawId::_nstraws; straw++) {
-	  pedestal_histos->BookHistos(tfs,
-				      "Pedestal_" + std::to_string(plane) + "_" +
-				      std::to_string(panel) + "_" +
-				      std::to_string(straw),
-				      plane, panel, straw);
-	}
-      }
-    }
+    pedestal_histos->BookStrawHistos(tfs, "Pedestal", histoSpecs_[HistoSpecs::kPedestal]);
   }
 
   if (doPanelHist_){
-    for (int plane = 0; plane <  mu2e::StrawId::_nplanes; plane++) {
-      for (int panel = 0; panel < mu2e::StrawId::_npanels; panel++) {
-	std::string   hName = "Panel_" + std::to_string(plane) + "_" + std::to_string(panel);
-	panel_histos->BookHistos(tfs, hName, plane, panel, -1);
-      }
+    panel_histos->BookPanelHistos(tfs, "Panel", histoSpecs_[HistoSpecs::kPanel]);
+  }
+
+  if (doTdcHist_){
+    tdc_histos->BookStrawHistos(tfs, "DeltaT", histoSpecs_[HistoSpecs::kDeltaT]);
+    tdc_panel_histos->BookPanelHistos(tfs, "PanelDeltaT", histoSpecs_[HistoSpecs::kPanelDeltaT]);
+  }
+
+  if (doIntegrity_){
+    book_integrity_histos(integrity_histos, tfs, histoSpecs_);
+    DQMClock::nsPerTick(); // the decode time is converted per event
+  }
+
+  if (doLatency_){
+    book_latency_histo(latency_histos, tfs, "EventLatency");
+    book_latency_histo(latency_histos, tfs, "DecodeLatency");
+    book_latency_histo(latency_histos, tfs, "FillLatency");
+    book_latency_histo(latency_histos, tfs, "PublishLatency");
+    book_latency_histo(latency_histos, tfs, "LatencyPerHit");
+    latency_histos->BookSummaryHistos(tfs, "HitMultiplicity", histoSpecs_[HistoSpecs::kHitMultiplicity]);
+    DQMClock::nsPerTick(); // calibrate now rather than on the first event
+  }
+
+  if (sampler_.enabled()){
+    sampling_histos->BookSummaryHistos(tfs, "SamplingFraction", 100, 0, 1);
+    //bin 1: sum of the weights (estimated input events), bin 2: analyzed events
+    sampling_histos->BookSummaryHistos(tfs, "SampledEvents", 2, 0, 2);
+    DQMClock::nsPerTick(); // event arrival and cost are converted per event
+  }
+
+  if (doTotHist_){
+    tot_histos->BookStrawHistos(tfs, "TOT", histoSpecs_[HistoSpecs::kTot]);
+    tot_panel_histos->BookPanelHistos(tfs, "PanelTOT", histoSpecs_[HistoSpecs::kPanelTot]);
+  }
+
+  TrackerHitSinks& sinks = inline_.sinks;
+  sinks.summary = summary_histos;
+  if (doPedestalHist_)  sinks.pedestal = pedestal_histos;
+  if (doPanelHist_)     sinks.panel    = panel_histos;
+  if (doTdcHist_)      {sinks.tdc      = tdc_histos; sinks.tdcPanel = tdc_panel_histos;}
+  if (doTotHist_)      {sinks.tot      = tot_histos; sinks.totPanel = tot_panel_histos;}
+  if (doStrawHealth_)   sinks.strawHealth = &strawHealth_;
+  if (doPedestalDrift_){
+    sinks.driftChannels = &inline_.driftChannels;
+    sinks.driftValues   = &inline_.driftValues;
+  }
+  if (conf_.fillBatchEvents() > 1) {
+    sinks.batch = new TrackerHitBatch(conf_.fillBatchEvents());
+    sinks.batch->bind(sinks);
+  }
+  inline_.integrity = &integrity_;
+
+  //room for the subrun totals, taken now so that no run transition allocates
+  if (conf_.subRunTotals()) {
+    totalsGroups_ = {{summary_histos, "summary"}, {panel_histos, "panels"},
+		     {tdc_panel_histos, "tdcPanels"}, {tot_panel_histos, "totPanels"}};
+    std::vector<const TrackerDQMHistoContainer*> containers;
+    for (const auto& group : totalsGroups_) containers.push_back(group.first);
+    totals_      = new HistoArena();
+    spareTotals_ = new HistoArena();
+    totals_->layout(containers);
+    spareTotals_->layout(containers);
+    __MOUT__ << "[TrackerDQM::beginJob] subrun totals of " << totals_->slots() << " histograms, "
+	     << 2 * totals_->bytes() << " bytes" << std::endl;
+  }
+
+  //the histograms are booked: build the publish groups once
+  book_groups_(summary_histos,   "summary",       false);
+  book_groups_(drift_histos,     "pedestalDrift", false, true);
+  book_groups_(health_histos,    "strawHealth",   false, true);
+  book_groups_(integrity_histos, "integrity",     false, true);
+  book_groups_(latency_histos,   "latency",       false);
+  book_groups_(sampling_histos,  "sampling",      false);
+  book_groups_(pedestal_histos,  "pedestals",     true);
+  book_groups_(panel_histos,     "panels",        true);
+  book_groups_(tdc_histos,       "tdc",           true);
+  book_groups_(tdc_panel_histos, "tdcPanels",     true);
+  book_groups_(tot_histos,       "tot",           true);
+  book_groups_(tot_panel_histos, "totPanels",     true);
+  if (publishStamp_) {
+    stampGroup_ = &hists_to_send_[moduleTag_+"_publishStamp"];
+    stampGroup_->reserve(1);
+  }
+  size_t nHistos = 0;
+  for (auto& group : hists_to_send_) {
+    nHistos += group.second.size();
+    group.second.clear();  //keeps the capacity
+  }
+  sent_.reserve(nHistos);
+
+  //the histograms are booked: lay them out in shared memory. The layout is
+  //fixed, so the lists rebinned at every publish stay out of it: the drifting
+  //and unhealthy straws and the per-link integrity counters
+  if (!conf_.sharedMemory().empty()) {
+    sharedExport_ = new SharedHisto::Writer(conf_.sharedMemory());
+    share_(summary_histos,   "summary",       false);
+    share_(integrity_histos, "integrity",     false, IntegrityHistos::kNLinkCounters);
+    share_(latency_histos,   "latency",       false);
+    share_(sampling_histos,  "sampling",      false);
+    share_(pedestal_histos,  "pedestals",     true);
+    share_(panel_histos,     "panels",        true);
+    share_(tdc_histos,       "tdc",           true);
+    share_(tdc_panel_histos, "tdcPanels",     true);
+    share_(tot_histos,       "tot",           true);
+    share_(tot_panel_histos, "totPanels",     true);
+    if (sharedExport_->create()) {
+      __MOUT__ << "[TrackerDQM::beginJob] histograms exported in " << conf_.sharedMemory() << ", "
+	       << sharedExport_->bytes() << " bytes" << std::endl;
+    } else {
+      __MOUT_ERR__ << "[TrackerDQM::beginJob] cannot create shared memory " << conf_.sharedMemory()
+		   << ": " << strerror(errno) << std::endl;
+      delete sharedExport_;
+      sharedExport_ = nullptr;
+    }
+  }
+
+  //the histograms are booked: the DQM and publishing threads can start
+  if (conf_.dqmWorkers() > 0 || scheduler_.timedGroups() != 0) {
+    ROOT::EnableThreadSafety();
+  }
+  if (scheduler_.timedGroups() != 0) {
+    scheduler_.start(PublishScheduler::Clock::now());
+    publisher_ = std::thread(&TrackerDQM::publisher_loop_, this);
+  }
+  if (conf_.dqmWorkers() > 0) {
+    queue_ = new FragmentRing<PendingEvent>(std::max(2, conf_.dqmQueueSize()));
+    for (int i = 0; i < conf_.dqmWorkers(); i++) {
+      replicas_.push_back(make_replica_());
+      workers_.emplace_back(&TrackerDQM::worker_, this, replicas_.back());
     }
   }
 }
 
 void ots::TrackerDQM::analyze(art::Event const& event) {
-  ++evtCounter_;
-  
+  //the DTC blocks are referenced in place when processed inline, and copied
+  //once when they must outlive this call (DQM threads, data requests)
+  //events beyond the CPU budget are skipped before any work is done on them;
+  //without a budget the clock is not read at all
+  if (sampler_.enabled() && !sampler_.accept(DQMClock::toNs(DQMClock::ticks()))) return;
+
+  bool keep = queue_ != nullptr || requestServer_ != nullptr;
+  pending_.number = event.event();
+  pending_.weight = sampler_.weight();
+  pending_.blocks.clear();
+
   std::vector<art::Handle<artdaq::Fragments>> fragmentHandles = event.getMany<std::vector<artdaq::Fragment>>();
 
   for (const auto& handle : fragmentHandles) {
@@ -136,112 +536,549 @@ void ots::TrackerDQM::analyze(art::Event const& event) {
 
     if (handle->front().type() == mu2e::detail::FragmentType::MU2EEVENT) {
       for (const auto& cont : *handle) {
-        mu2e::Mu2eEventFragment mef(cont);
+        //locate the blocks in the kept copy, so that they point into it
+        std::shared_ptr<const artdaq::Fragment> kept;
+        if (keep) kept = DataRequestServer::keep(cont);
+        mu2e::Mu2eEventFragment mef(kept ? *kept : cont);
         for (size_t ii = 0; ii < mef.tracker_block_count(); ++ii) {
           auto pair = mef.trackerAtPtr(ii);
-          mu2e::TrackerFragment cc(pair);
-          analyze_tracker_(cc);
+          pending_.blocks.push_back({kept, pair.first, pair.second});
         }
       }
     } else {
       if (handle->front().type() == mu2e::detail::FragmentType::TRK) {
-        for (auto frag : *handle) {
-          mu2e::TrackerFragment cc(frag.dataBegin(), frag.dataSizeBytes());
-          analyze_tracker_(cc);
+        for (const auto& frag : *handle) {
+          if (keep) {
+            auto kept = DataRequestServer::keep(frag);
+            pending_.blocks.push_back({kept, kept->dataBegin(), kept->dataSizeBytes()});
+          } else {
+            pending_.blocks.push_back({nullptr, frag.dataBegin(), frag.dataSizeBytes()});
+          }
         }
       }
     }
   }
 
+  if (requestServer_) {
+    requestBlocks_.assign(pending_.blocks.begin(), pending_.blocks.end());
+    requestServer_->addEvent(pending_.number, std::move(requestBlocks_));
+  }
+
+  if (queue_ == nullptr) {
+    process_event_(pending_, inline_);
+    return;
+  }
+
+  //hand the event off; under overload either wait for a free slot or skip it,
+  //telling the sampler so that the weights account for the skipped events
+  while (!queue_->push(pending_)) {
+    if (sampleOnOverload_) {
+      ++droppedEvents_;
+      if (sampler_.enabled()) sampler_.dropped();
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+  }
+  ++queued_;
 }
 
-void  ots::TrackerDQM::analyze_tracker_(const mu2e::TrackerFragment& cc) {
-  for (size_t curBlockIdx = 0; curBlockIdx < cc.block_count(); curBlockIdx++) { // iterate over straws
-    auto block_data = cc.dataAtBlockIndex(curBlockIdx);
-    if (block_data == nullptr) {
-      mf::LogError("TrackerDQM") << "Unable to retrieve header from block "
-				 << curBlockIdx << "!" << std::endl;
-      continue;
+//copies of everything inline_ fills, for one DQM thread
+ots::TrackerDQM::FillState* ots::TrackerDQM::make_replica_() {
+  FillState* st = new FillState();
+  st->replica = true;
+  st->sinks   = inline_.sinks;
+  for (TrackerDQMHistoContainer** sink : {&st->sinks.summary, &st->sinks.pedestal, &st->sinks.panel,
+					  &st->sinks.tdc, &st->sinks.tdcPanel, &st->sinks.tot, &st->sinks.totPanel}) {
+    if (*sink == nullptr) continue;
+    st->histos.push_back({*sink, (*sink)->MakeReplica()});
+    *sink = st->histos.back().second;
+  }
+  st->integrity = new DataIntegrityMonitor();
+  if (doStrawHealth_) {
+    st->sinks.strawHealth = new StrawHealthMonitor(TrackerLayout::kNChannels, TrackerLayout::kStraws, conf_.healthPeriod(),
+						   conf_.deadSigma(), conf_.hotSigma(), conf_.minMedian());
+  }
+  if (doPedestalDrift_) {
+    st->sinks.driftChannels = &st->driftChannels;
+    st->sinks.driftValues   = &st->driftValues;
+  }
+  if (st->sinks.batch) {
+    st->sinks.batch = new TrackerHitBatch(conf_.fillBatchEvents());
+    st->sinks.batch->bind(st->sinks);
+  }
+  return st;
+}
+
+void ots::TrackerDQM::worker_(FillState* st) {
+  PendingEvent ev;
+  for (;;) {
+    if (queue_->pop(ev)) {
+      process_event_(ev, *st);
+      ev.blocks.clear();
+      ++processed_;
+    } else if (stopWorkers_) {
+      break;
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
     }
-    auto hdr = block_data->GetHeader();
-    if (hdr->GetPacketCount() > 0) {
-      auto trkDatas = cc.GetTrackerData(curBlockIdx);
-      if (trkDatas.empty()) {
-	mf::LogError("TrackerDQM")
-	  << "Error retrieving Tracker data from DataBlock " << curBlockIdx
-	  << "!";
-	continue;
-      }
+  }
+}
 
-      for (auto& trkData : trkDatas) {
-	mu2e::StrawId sid(trkData.first->StrawIndex);
-	//mu2e::TrkTypes::TDCValues tdc = {	    static_cast<uint16_t>(trkData.first->TDC0()),	    static_cast<uint16_t>(trkData.first->TDC1()) };
-	//mu2e::TrkTypes::TOTValues tot = { trkData.first->TOT0,					    trkData.first->TOT1 };
-	mu2e::TrkTypes::ADCWaveform adcs(trkData.second.begin(), trkData.second.end());
-	summary_fill(summary_histos, sid);
-		  
-	for (std::string name : histType_) {
-	  if (name == "pedestals") {
-	    pedestal_fill(pedestal_histos, pedestal_est(adcs), "Pedestal", sid);
-	  }
-	  else if (name == "panels") {
-	    panel_fill(panel_histos, "Panel", sid);
-	  } 
-	  else {
-	    __MOUT_ERR__ << "Unrecognized histogram type" << std::endl;
-	  }
-	}
-      }
+//decode, fill and publish one event. A DQM thread fills its replicas under
+//their own lock, which only a merge ever contends, and takes the shared fill
+//lock for the per-event monitors and the publish only
+void ots::TrackerDQM::process_event_(const PendingEvent& ev, FillState& st) {
+  std::unique_lock<std::mutex> lock(st.replica ? st.mutex : fillMutex_);
+  uint64_t eventStart = DQMClock::ticks();
+  st.decodeTicks = 0;
+  st.hits = 0;
+  st.sinks.weight = ev.weight;
+  if (doIntegrity_) st.integrity->beginEvent();
+
+  for (const auto& block : ev.blocks) {
+    if (doIntegrity_) st.integrity->addFragment(block.size);
+    mu2e::TrackerFragment cc(block.data, block.size);
+    analyze_tracker_(cc, st);
+  }
+  if (st.sinks.batch && st.sinks.batch->endEvent()) st.sinks.batch->flush();
+  uint64_t eventBytes = 0;
+  if (doIntegrity_) {
+    st.integrity->addDecodeNs(DQMClock::toNs(st.decodeTicks));  //the block walk only, not the fills
+    st.integrity->endEvent();
+    eventBytes = st.integrity->lastEventBytes();
+  }
+  if (st.replica) {
+    lock.unlock();
+    lock = std::unique_lock<std::mutex>(fillMutex_);
+  }
+
+  ++evtCounter_;
+  if (doIntegrity_) {
+    integrity_histos->histograms[IntegrityHistos::kEventKBytes]._Hist->Fill(eventBytes / 1024.);
+  }
+
+  if (doPedestalDrift_){
+    pedestalDrift_.update(st.driftChannels, st.driftValues);
+    st.driftChannels.clear();
+    st.driftValues.clear();
+  }
+
+  if (doStrawHealth_){
+    if (strawHealth_.checkDue()) merge_replicas_(false);  //the check needs the counts of every thread
+    if (strawHealth_.endEvent() && diagLevel_>0){
+      __MOUT__ << "[TrackerDQM::analyze] dead straws: "<< strawHealth_.dead().size()
+	       << ", hot straws: "<< strawHealth_.hot().size() << std::endl;
     }
   }
-    
 
-  if (evtCounter_ % freqDQM_  != 0) return;
-  
+  uint64_t eventNs = sampler_.enabled() || doLatency_ ? DQMClock::toNs(DQMClock::ticks() - eventStart) : 0;
+  if (sampler_.enabled()) {
+    sampler_.processed(eventNs);
+    sampling_histos->histograms[0]._Hist->Fill(1. / ev.weight);
+    sampling_histos->histograms[1]._Hist->Fill(0., ev.weight);
+    sampling_histos->histograms[1]._Hist->Fill(1.);
+  }
+
+  if (doLatency_) {
+    uint64_t decodeNs = DQMClock::toNs(st.decodeTicks);
+    latency_[kEventLatency].record(eventNs);
+    latency_[kDecodeLatency].record(decodeNs);
+    latency_[kFillLatency].record(eventNs > decodeNs ? eventNs - decodeNs : 0);
+    if (st.hits > 0) latency_[kHitLatency].record(eventNs / st.hits);
+    latency_histos->histograms[kNLatencies]._Hist->Fill(st.hits);
+  }
+
+  //groups without a publish interval follow the event count
+  PublishScheduler::GroupMask groups = scheduler_.untimedGroups();
+  if (groups == 0 || evtCounter_ % freqDQM_  != 0) return;
+
+  ScopedTimer publishTimer(doLatency_ ? &latency_[kPublishLatency] : nullptr);
+  publish_(groups);
+}
+
+//publish the timed groups on their deadlines, whether events arrive or not
+void ots::TrackerDQM::publisher_loop_() {
+  while (!stopPublisher_) {
+    auto wake = std::min(scheduler_.next(), PublishScheduler::Clock::now() + std::chrono::milliseconds(100));
+    std::this_thread::sleep_until(wake);
+
+    std::lock_guard<std::mutex> lock(fillMutex_);
+    PublishScheduler::GroupMask groups = scheduler_.due(PublishScheduler::Clock::now());
+    if (groups == 0) continue;
+    ScopedTimer publishTimer(doLatency_ ? &latency_[kPublishLatency] : nullptr);
+    publish_(groups);
+  }
+}
+
+void  ots::TrackerDQM::analyze_tracker_(const mu2e::TrackerFragment& cc, FillState& st) {
+  size_t nHits = fill_tracker_fragment(cc, st.sinks, doIntegrity_ ? st.integrity : nullptr,
+				       doLatency_ || doIntegrity_ ? &st.decodeTicks : nullptr);
+  st.hits += nHits;
+}
+
+void ots::TrackerDQM::publish_(PublishScheduler::GroupMask groups) {
+  auto due = [groups](int group) { return (groups >> group) & 1; };
+  flush_stats_();
   if (diagLevel_>0){
     __MOUT__ << "[TrackerDQM::analyze] preparing the BUFFER..."<< std::endl;
   }
 
-  //send a packet AND reset the histograms
-  std::map<std::string,std::vector<TH1*>>   hists_to_send;
+  //send a packet AND reset the histograms: send_ copies each histogram into
+  //its snapshot, the histograms are cleared after the send
   
   //send the summary hists
-  for (size_t i = 0; i < summary_histos->histograms.size(); i++) {
+  for (size_t i = 0; due(kSummaryGroup) && i < summary_histos->histograms.size(); i++) {
     __MOUT__ << "[TrackerDQM::analyze] collecting summary histogram "<< summary_histos->histograms[i]._Hist << std::endl;
-    hists_to_send[moduleTag_+"_summary"].push_back((TH1*)summary_histos->histograms[i]._Hist->Clone());
-    summary_histos->histograms[i]._Hist->Reset();
+    send_(summary_histos, i, true);
   }
 
-  for (std::string name : histType_) {
+  //send only the straws whose pedestal is drifting
+  if (doPedestalDrift_ && due(kPedestalDriftGroup)) {
+    const auto& alarms = pedestalDrift_.findAlarms();
     if (diagLevel_>0){
-      __MOUT__ << "[TrackerDQM::analyze] collecting histograms from the block: "<< name << std::endl;
-    }
-    if (name == "pedestals") {   
-      //prepare the vector of histograms
-      for (size_t i = 0; i < pedestal_histos->histograms.size(); i++) {
-	hists_to_send[moduleTag_+"_"+name+"/plane_"+std::to_string(pedestal_histos->histograms[i].plane)+
-		      "/panel_" +std::to_string(pedestal_histos->histograms[i].panel)].push_back((TH1*)pedestal_histos->histograms[i]._Hist->Clone());
-	pedestal_histos->histograms[i]._Hist->Reset();
-      }
-    }else if(name == "panels") {
-      if (diagLevel_>0){
-	__MOUT__ << Form("[%s::analyze] preparing the collection of hists for  ", moduleTag_.data())<< name << " histograms"<< std::endl;
-      }
-      //prepare the vector of histograms
-      __MOUT__ << Form("[%sDQM::analyze] N hists =  ", moduleTag_.data())<< panel_histos->histograms.size() << std::endl;
-      for (size_t i = 0; i < panel_histos->histograms.size(); i++) {
-      	std::string  refName = moduleTag_+"_"+name+"/plane_"+std::to_string(panel_histos->histograms[i].plane);
-      	hists_to_send[refName].push_back((TH1*)panel_histos->histograms[i]._Hist->Clone());
-      	panel_histos->histograms[i]._Hist->Reset();
-      }
+      __MOUT__ << "[TrackerDQM::analyze] straws with drifting pedestal: "<< alarms.size() << std::endl;
+    }
+    drift_alarm_fill(drift_histos->histograms[0]._Hist, alarms);
+    send_(drift_histos, 0, false);
+  }
+
+  //send the straws flagged by the last health check
+  if (doStrawHealth_ && due(kStrawHealthGroup)) {
+    straw_health_fill(health_histos->histograms[0]._Hist, strawHealth_.dead());
+    straw_health_fill(health_histos->histograms[1]._Hist, strawHealth_.hot());
+    for (size_t i = 0; i < health_histos->histograms.size(); i++) {
+      send_(health_histos, i, false);
+    }
+  }
+
+  //send the link counters and throughput, then start a new counting window
+  if (doIntegrity_ && due(kIntegrityGroup)) {
+    integrity_fill(integrity_histos, integrity_);
+    for (size_t i = 0; i < integrity_histos->histograms.size(); i++) {
+      send_(integrity_histos, i, i == IntegrityHistos::kEventKBytes);
+    }
+    integrity_.reset();
+  }
+
+  //send the timing of the DQM itself
+  if (doLatency_ && due(kLatencyGroup)) {
+    for (int i = 0; i < kNLatencies; i++) {
+      latency_fill(latency_histos->histograms[i]._Hist, latency_[i]);
+      latency_[i].reset();
+    }
+    for (size_t i = 0; i < latency_histos->histograms.size(); i++) {
+      send_(latency_histos, i, i == kNLatencies);
+    }
+  }
+
+  //send the sampling fraction, to normalize the weighted histograms downstream
+  if (sampler_.enabled() && due(kSamplingGroup)) {
+    for (size_t i = 0; i < sampling_histos->histograms.size(); i++) {
+      send_(sampling_histos, i, true);
     }
   }
 
-  histSender_->sendHistograms(hists_to_send);
+  //per-straw histograms: with subscriptions, only the subscribed panels
+  if (doPedestalHist_ && due(kPedestalGroup)) {
+    collect_(pedestal_histos, "pedestals", detail_panels_(kPedestalDetail));
+  }
+  if (doPanelHist_ && due(kPanelGroup))       collect_(panel_histos,     "panels");
+  if (doTdcHist_ && due(kTdcGroup)) {
+    collect_(tdc_histos,       "tdc",       detail_panels_(kTdcDetail));
+    collect_(tdc_panel_histos, "tdcPanels");
+  }
+  if (doTotHist_ && due(kTotGroup)) {
+    collect_(tot_histos,       "tot",       detail_panels_(kTotDetail));
+    collect_(tot_panel_histos, "totPanels");
+  }
+
+  //local consumers get every shared histogram, filled as above and before the
+  //clears after the send
+  if (sharedExport_) sharedExport_->update(PublishStamp::nowNs());
+
+  if (publishStamp_) {
+    PublishStamp::stamp(publishStamp_.get(), publishCount_);
+    stampGroup_->push_back(publishStamp_.get());
+  }
+  ++publishCount_;
+
+  //only the groups with histograms go out; the node moves allocate nothing
+  for (auto it = hists_to_send_.begin(); it != hists_to_send_.end();) {
+    auto next = std::next(it);
+    if (it->second.empty()) idleGroups_.insert(hists_to_send_.extract(it));
+    it = next;
+  }
+  if (binarySender_) {
+    send_binary_(hists_to_send_);
+  } else {
+    histSender_->sendHistograms(hists_to_send_);
+  }
+  hists_to_send_.merge(idleGroups_);
+  for (auto& group : hists_to_send_) group.second.clear();
+
+  for (const auto& hist : sent_) clear_(hist.first, hist.second);
+  sent_.clear();
+}
+
+//queue a snapshot of histogram i of histos in its publish group; the
+//histogram itself is cleared after the send when asked
+void ots::TrackerDQM::send_(TrackerDQMHistoContainer* histos, size_t i, bool clear) {
+  PublishSlot& slot = publishGroups_.find(histos)->second[i];
+  TH1F*        hist = histos->histograms[i]._Hist;
+  if (slot.rebinned || hist->GetNcells() != slot.snapshot->GetNcells()) {
+    hist->Copy(*slot.snapshot);  //binning and labels too
+    slot.snapshot->SetDirectory(nullptr);
+  } else {
+    TrackerDQMHistoContainer::CopyHist(hist, slot.snapshot.get());
+  }
+  slot.group->push_back(slot.snapshot.get());
+  if (clear) sent_.push_back({histos, i});
+}
+
+//one BinaryHisto frame per publish
+void ots::TrackerDQM::send_binary_(const std::map<std::string,std::vector<TH1*>>& hists_to_send) {
+  binaryWriter_.begin();
+  for (const auto& group : hists_to_send) {
+    for (TH1* h : group.second) binaryWriter_.add(group.first, h);
+  }
+  const std::string& frame  = binaryWriter_.finish();
+  const std::string& packet = compressor_.compress(frame);
+  if (diagLevel_>0){
+    __MOUT__ << "[TrackerDQM::publish] binary frame of " << frame.size() << " bytes, "
+	     << packet.size() << " sent" << std::endl;
+  }
+
+  //a missing receiver costs one connection attempt per publish
+  try {
+    if (!binaryConnected_) binaryConnected_ = binarySender_->connect(1, 0);
+    if (binaryConnected_)  binarySender_->sendPacket(packet);
+  } catch (const std::exception& e) {
+    __MOUT_ERR__ << "[TrackerDQM::publish] binary send failed: " << e.what() << std::endl;
+    delete binarySender_;
+    binarySender_    = new TCPSendClient(address_, port_);
+    binaryConnected_ = false;
+  }
 }
 
-void ots::TrackerDQM::endJob() {}
+//panels subscribed to a per-straw group, nullptr when every panel is sent
+const std::vector<bool>* ots::TrackerDQM::detail_panels_(int detail) {
+  if (subscriptions_ == nullptr) return nullptr;
+  subscriptions_->subscribed(detail, detailPanels_);
+  return &detailPanels_;
+}
 
-void ots::TrackerDQM::beginRun(const art::Run& run) {}
+//straw histograms are grouped per panel, panel histograms per plane. When
+//panels is given, the histograms of the other panels are neither sent nor
+//reset: they keep accumulating until someone subscribes to them
+void ots::TrackerDQM::collect_(TrackerDQMHistoContainer* histos, const std::string& name,
+			       const std::vector<bool>* panels) {
+  if (diagLevel_>0){
+    __MOUT__ << "[TrackerDQM::analyze] collecting histograms from the block: "<< name
+	     << ", N hists = " << histos->histograms.size() << std::endl;
+  }
+  for (size_t i = 0; i < histos->histograms.size(); i++) {
+    if (panels && !(*panels)[TrackerLayout::panelIndex(histos->histograms[i].plane, histos->histograms[i].panel)]) {
+      continue;
+    }
+    send_(histos, i, true);
+  }
+}
+
+std::string ots::TrackerDQM::group_path_(const std::string& name,
+					 const TrackerDQMHistoContainer::summaryInfoHist_& hist) const {
+  std::string refName = moduleTag_+"_"+name+"/plane_"+std::to_string(hist.plane);
+  if (hist.straw >= 0) {
+    refName += "/panel_" +std::to_string(hist.panel);
+  }
+  return refName;
+}
+
+//register the histograms of a container from `first` on with the shared-memory
+//export, under the same group names as the published histograms
+void ots::TrackerDQM::share_(TrackerDQMHistoContainer* histos, const std::string& name, bool perPlane, size_t first) {
+  for (size_t i = first; i < histos->histograms.size(); ++i) {
+    const auto& hist = histos->histograms[i];
+    sharedExport_->add(perPlane ? group_path_(name, hist) : moduleTag_+"_"+name, hist._Hist);
+  }
+}
+
+//the publish group and snapshot of each histogram of a container, the same
+//names as share_; rebinned for the containers rebinned or relabelled at publish
+void ots::TrackerDQM::book_groups_(TrackerDQMHistoContainer* histos, const std::string& name, bool perPlane,
+				   bool rebinned) {
+  std::vector<PublishSlot>& slots = publishGroups_[histos];
+  for (const auto& hist : histos->histograms) {
+    std::vector<TH1*>* group = &hists_to_send_[perPlane ? group_path_(name, hist) : moduleTag_+"_"+name];
+    std::unique_ptr<TH1F> snapshot(new TH1F(*hist._Hist));
+    snapshot->SetDirectory(nullptr);
+    group->push_back(snapshot.get());  //sizes the vector for the group
+    slots.push_back(PublishSlot{group, std::move(snapshot), rebinned});
+  }
+}
+
+//fold the replicas of the DQM threads into the shared monitors and, with
+//histos, histograms; called with fillMutex_ held or the threads stopped
+void ots::TrackerDQM::merge_replicas_(bool histos) {
+  for (FillState* st : replicas_) {
+    std::lock_guard<std::mutex> lock(st->mutex);
+    if (doStrawHealth_) strawHealth_.merge(*st->sinks.strawHealth);
+    if (doIntegrity_)   integrity_.merge(*st->integrity);
+    if (!histos) continue;
+    if (st->sinks.batch) st->sinks.batch->flush();
+    for (auto& pair : st->histos) pair.first->MergeReplica(*pair.second);
+  }
+}
+
+//fills kept aside by the DQM threads, the hit batch and uniform_fill/integer_fill
+//into the histograms, before anyone reads them
+void ots::TrackerDQM::flush_stats_() {
+  merge_replicas_(true);
+  if (inline_.sinks.batch) inline_.sinks.batch->flush();
+  for (TrackerDQMHistoContainer* histos : {summary_histos, pedestal_histos, panel_histos, tdc_histos,
+					   tdc_panel_histos, tot_histos, tot_panel_histos}) {
+    histos->FlushPending();
+  }
+}
+
+//empty histogram i of histos once it is published, adding it to the subrun
+//totals when they are kept for it
+void ots::TrackerDQM::clear_(TrackerDQMHistoContainer* histos, size_t i) {
+  long first = totals_ ? totals_->find(histos) : -1;
+  if (first >= 0) totals_->add(first + i, histos->histograms[i]._Hist);
+  histos->Clear(i);
+}
+
+//wait until the DQM threads are done with every event handed to them
+void ots::TrackerDQM::drain_() {
+  while (processed_ < queued_) std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+//every histogram and monitor starts over; called with fillMutex_ held, after
+//a publish_ of all the groups has merged the replicas and sent the contents
+void ots::TrackerDQM::reset_state_() {
+  for (TrackerDQMHistoContainer* histos : {summary_histos, pedestal_histos, panel_histos, drift_histos, health_histos,
+					   tdc_histos, tdc_panel_histos, tot_histos, tot_panel_histos,
+					   integrity_histos, latency_histos, sampling_histos}) {
+    histos->Clear();
+  }
+  integrity_.reset();
+  pedestalDrift_.reset();
+  strawHealth_.reset();
+  for (auto& latency : latency_) latency.reset();
+}
+
+//one histogram per slot of the totals under run_R/subrun_S/<group>. The copies
+//are booked from the binning only: the live histograms may be published and
+//cleared meanwhile by the publisher thread
+void ots::TrackerDQM::write_totals_(const HistoArena& totals, art::RunNumber_t run, art::SubRunNumber_t subRun) {
+  art::TFileDirectory dir = tfs->mkdir("run_" + std::to_string(run)).mkdir("subrun_" + std::to_string(subRun));
+  for (const auto& group : totalsGroups_) {
+    if (group.first->histograms.empty()) continue;
+    art::TFileDirectory groupDir = dir.mkdir(group.second);
+    long first = totals.find(group.first);
+    for (size_t i = 0; i < group.first->histograms.size(); i++) {
+      const auto& hist = group.first->histograms[i];
+      TH1F* total = groupDir.make<TH1F>(hist._Hist->GetName(), hist._Hist->GetTitle(),
+					hist.axis.n, hist.axis.min, hist.axis.max);
+      totals.copyTo(first + i, total);
+    }
+  }
+}
+
+void ots::TrackerDQM::endJob() {
+  if (sampler_.enabled()) {
+    __MOUT__ << "[TrackerDQM::endJob] events analyzed: " << sampler_.accepted() << " of " << sampler_.seen()
+	     << ", last sampling fraction " << sampler_.fraction() << std::endl;
+  }
+  if (queue_) {
+    //the workers drain the queue before leaving
+    stopWorkers_ = true;
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+    if (droppedEvents_ > 0) {
+      __MOUT__ << "[TrackerDQM::endJob] events skipped under overload: " << droppedEvents_ << std::endl;
+    }
+  }
+  if (publisher_.joinable()) {
+    stopPublisher_ = true;
+    publisher_.join();
+    if (scheduler_.skipped() > 0) {
+      __MOUT__ << "[TrackerDQM::endJob] publish slots missed: " << scheduler_.skipped() << std::endl;
+    }
+  }
+  //the publisher thread is gone: nothing uses the senders any more
+  flush_stats_();  //before the TFileService writes the histograms
+  for (FillState* st : replicas_) {
+    for (auto& pair : st->histos) delete pair.second;
+    delete st->sinks.strawHealth;
+    delete st->sinks.batch;
+    delete st->integrity;
+    delete st;
+  }
+  replicas_.clear();
+  delete inline_.sinks.batch;
+  inline_.sinks.batch = nullptr;
+  delete totals_;
+  delete spareTotals_;
+  totals_ = spareTotals_ = nullptr;
+  if (sharedExport_) {
+    sharedExport_->close();
+    delete sharedExport_;
+    sharedExport_ = nullptr;
+  }
+  if (compressor_.enabled()) {
+    __MOUT__ << "[TrackerDQM::endJob] frame compression\n" << compressor_.summary() << std::endl;
+  }
+  if (binarySender_) {
+    delete binarySender_;
+    binarySender_ = nullptr;
+  }
+  if (subscriptions_) {
+    subscriptions_->stop();
+    delete subscriptions_;
+    subscriptions_ = nullptr;
+  }
+  if (requestServer_) {
+    __MOUT__ << "[TrackerDQM::endJob] data requests served: " << requestServer_->requests() << std::endl;
+    requestServer_->stop();
+    delete requestServer_;
+    requestServer_ = nullptr;
+  }
+}
+
+//the previous run was cleared at its end, so its first events find empty,
+//already allocated histograms and nothing left to do here
+void ots::TrackerDQM::beginRun(const art::Run& run) {
+  if (diagLevel_>0){
+    __MOUT__ << "[TrackerDQM::beginRun] run " << run.run() << std::endl;
+  }
+}
+
+//the last publish of the subrun, then the totals flip to the spare arena: the
+//next subrun fills one while the finished one is written and cleared
+void ots::TrackerDQM::endSubRun(const art::SubRun& subRun) {
+  if (totals_ == nullptr && resetOn_ != kResetSubRun) return;
+  drain_();
+  {
+    std::lock_guard<std::mutex> lock(fillMutex_);
+    publish_((PublishScheduler::GroupMask(1) << kNGroups) - 1);
+    std::swap(totals_, spareTotals_);
+    if (resetOn_ == kResetSubRun) reset_state_();
+  }
+  if (spareTotals_) {
+    write_totals_(*spareTotals_, subRun.run(), subRun.subRun());
+    spareTotals_->clear();
+  }
+}
+
+//the reset happens here rather than in beginRun, between runs, where it
+//does not add to the latency of any event
+void ots::TrackerDQM::endRun(const art::Run& run) {
+  if (resetOn_ != kResetRun) return;
+  drain_();
+  std::lock_guard<std::mutex> lock(fillMutex_);
+  publish_((PublishScheduler::GroupMask(1) << kNGroups) - 1);
+  reset_state_();
+}
 
 DEFINE_ART_MODULE(ots::TrackerDQM)
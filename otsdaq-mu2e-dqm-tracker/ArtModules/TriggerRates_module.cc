@@ -10,6 +10,7 @@
 #include "art/Framework/Principal/Event.h"
 #include "art/Framework/Principal/Handle.h"
 #include "art/Framework/Principal/Run.h"
+#include "art/Framework/Principal/SubRun.h"
 #include "art/Framework/Services/System/TriggerNamesService.h"
 #include "art_root_io/TFileDirectory.h"
 #include "art_root_io/TFileService.h"
@@ -99,7 +100,7 @@ public:
   void beginRun(art::Run const &) override;
   void beginJob() override;
   void endJob() override;
-  void endSubRun(const art::SubRun &sr);
+  void endSubRun(const art::SubRun &sr) override;
   enum {
     kNTrigInfo = 40,
     kNTrackTrig = 20,
@@ -277,6 +278,7 @@ private:
 
   std::vector<trigInfo_> _trigAll;
   std::vector<trigInfo_> _trigFinal;
+  std::vector<int> _subRunCounts; // _trigFinal counts at the last endSubRun
   std::vector<trigInfo_> _trigCaloOnly;
   std::vector<trigInfo_> _trigCaloCalib;
   std::vector<trigInfo_> _trigTrack;
@@ -325,6 +327,7 @@ ots::TriggerRates::TriggerRates(fhicl::ParameterSet const &pset)
   TLOG(TLVL_INFO) << "TriggerRate Plotter construction is beginning ";
   _trigAll.resize(_nMaxTrig);
   _trigFinal.resize(_nMaxTrig);
+  _subRunCounts.resize(_nMaxTrig, 0);
   _trigCaloOnly.resize(_nMaxTrig);
   _trigCaloCalib.resize(_nMaxTrig);
   _trigTrack.resize(_nMaxTrig);
@@ -1298,7 +1301,28 @@ void ots::TriggerRates::beginRun(const art::Run &run) {
   _tracker = th.get();
 }
 
-void ots::TriggerRates::endSubRun(const art::SubRun &sr) {}
+// Counts of each trigger in the subrun, kept under run_R/subrun_S; the job
+// totals in _trigFinal go on accumulating for endJob
+void ots::TriggerRates::endSubRun(const art::SubRun &sr) {
+  art::TFileDirectory subRunDir =
+      tfs->mkdir("run_" + std::to_string(sr.run()))
+          .mkdir("subrun_" + std::to_string(sr.subRun()));
+  TH1F *counts = subRunDir.make<TH1F>("trigCounts", "Trigger counts",
+                                      _nMaxTrig, 0., _nMaxTrig);
+  double entries = 0;
+  for (size_t i = 0; i < _trigFinal.size(); ++i) {
+    if (_trigFinal[i].label.empty())
+      continue;
+    int n = _trigFinal[i].counts - _subRunCounts[i];
+    counts->GetXaxis()->SetBinLabel(i + 1, _trigFinal[i].label.c_str());
+    counts->SetBinContent(i + 1, n);
+    entries += n;
+    _subRunCounts[i] = _trigFinal[i].counts;
+  }
+  counts->SetEntries(entries);
+  TLOG(TLVL_DEBUG) << "Subrun " << sr.run() << ":" << sr.subRun() << ", "
+                   << entries << " triggers";
+}
 
 void ots::TriggerRates::findTrigIndex(std::vector<trigInfo_> &Vec,
                                       std::string &ModuleLabel, int &Index) {
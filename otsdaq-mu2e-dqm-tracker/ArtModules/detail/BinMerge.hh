@@ -0,0 +1,43 @@
+#ifndef OTSDAQ_DQM_ARTMODULES_DETAIL_BINMERGE_HH
+#define OTSDAQ_DQM_ARTMODULES_DETAIL_BINMERGE_HH
+
+// Element-wise addition of bin arrays, used to merge per-thread histogram
+// replicas. The loop works on 32-byte GCC/Clang vector-extension registers
+// (one AVX or two SSE/NEON operations per step, whatever the target allows)
+// with unaligned loads through memcpy; the additions are the same IEEE
+// operations as the scalar loop, so the result does not depend on the width.
+
+#include <cstddef>
+#include <cstring>
+
+namespace ots {
+namespace detail {
+
+// dst[i] += src[i] for i < n
+template <class T>
+inline void add_bins(T *__restrict dst, const T *__restrict src, size_t n) {
+  typedef T Vec __attribute__((vector_size(32)));
+  constexpr size_t kLanes = sizeof(Vec) / sizeof(T);
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    Vec a, b;
+    std::memcpy(&a, dst + i, sizeof(Vec));
+    std::memcpy(&b, src + i, sizeof(Vec));
+    a += b;
+    std::memcpy(dst + i, &a, sizeof(Vec));
+  }
+  for (; i < n; ++i)
+    dst[i] += src[i];
+}
+
+// as add_bins, then src[i] = 0: the replica starts over after a merge
+template <class T>
+inline void move_bins(T *__restrict dst, T *__restrict src, size_t n) {
+  add_bins(dst, src, n);
+  std::memset(src, 0, n * sizeof(T));
+}
+
+} // namespace detail
+} // namespace ots
+
+#endif // OTSDAQ_DQM_ARTMODULES_DETAIL_BINMERGE_HH
@@ -1,7 +1,12 @@
 #ifndef OTSDAQ_DQM_ARTMODULES_DETAIL_DATAREQUESTMESSAGE_HH
 #define OTSDAQ_DQM_ARTMODULES_DETAIL_DATAREQUESTMESSAGE_HH
 
+#include <cstdint>
+
 namespace ots {
+// Both structures travel as raw bytes between hosts of the same architecture.
+// A response is the header followed, for each fragment, by its size in bytes
+// (uint64_t) and its payload; see DataRequestServer.hh.
 struct DataRequestMessage {
   uint32_t eventNumber;
   bool wantMWPC;
@@ -0,0 +1,148 @@
+#ifndef OTSDAQ_DQM_ARTMODULES_DETAIL_DATAREQUESTSERVER_HH
+#define OTSDAQ_DQM_ARTMODULES_DETAIL_DATAREQUESTSERVER_HH
+
+// On-demand access to the raw tracker data of recent events. The DQM module
+// keeps the last N events in a ring; a client sends a DataRequestMessage and
+// receives a DataResponseHeader followed by the tracker DTC blocks of that
+// event (eventNumber 0 asks for the most recent one). The blocks are shared
+// with the ring and written straight from it with gathered writes: once an
+// event is buffered, serving it makes no copy. An answer the client does not
+// read holds its blocks until it is sent or the client goes; the listener
+// thread moves on to other clients. wantMWPC/wantSTIB are
+// test-beam flags and are ignored, the tracker blocks are always sent.
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/DataRequestMessage.hh"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/RequestListener.hh"
+
+#include <artdaq-core/Data/Fragment.hh>
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ots {
+class DataRequestServer {
+public:
+  // a tracker DTC payload, kept alive by the artdaq fragment holding it
+  struct Block {
+    std::shared_ptr<const artdaq::Fragment> owner;
+    const void *data;
+    size_t size;
+  };
+
+  DataRequestServer(int port, size_t capacity)
+      : ring_(capacity), next_(0), stored_(0), requests_(0),
+        listener_(port,
+                  [this](RequestListener::Connection &c) { return serve_(c); }) {}
+
+  bool start() { return listener_.start(); }
+  void stop() { listener_.stop(); }
+
+  // Copy of a fragment owned by the ring; the only copy made per event
+  static std::shared_ptr<const artdaq::Fragment>
+  keep(const artdaq::Fragment &frag) {
+    return std::make_shared<const artdaq::Fragment>(frag);
+  }
+
+  // Store the blocks of one event, replacing the oldest one when full
+  void addEvent(uint64_t eventNumber, std::vector<Block> &&blocks) {
+    if (ring_.empty())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Entry &e = ring_[next_];
+      e.eventNumber = eventNumber;
+      e.blocks.swap(blocks);
+      next_ = (next_ + 1) % ring_.size();
+      if (stored_ < ring_.size())
+        ++stored_;
+    }
+    // the evicted event is released outside the lock; the caller gets its
+    // vector back, with its capacity, for the next event
+    blocks.clear();
+  }
+
+  uint64_t requests() const { return requests_; }
+
+private:
+  struct Entry {
+    uint64_t eventNumber = 0;
+    std::vector<Block> blocks;
+  };
+
+  // what one answer writes from, alive until the listener has sent it
+  struct Reply {
+    DataResponseHeader header;
+    std::vector<uint64_t> sizes;
+    std::vector<Block> blocks;
+  };
+
+  // Answer the complete requests received so far; false closes the connection
+  bool serve_(RequestListener::Connection &c) {
+    size_t used = 0;
+    for (; c.in.size() - used >= sizeof(DataRequestMessage);
+         used += sizeof(DataRequestMessage)) {
+      DataRequestMessage request;
+      std::memcpy(&request, c.in.data() + used, sizeof(request));
+      if (!request.isValid())
+        return false;
+      answer_(request, c);
+    }
+    c.in.erase(0, used);
+    return true;
+  }
+
+  void answer_(const DataRequestMessage &request,
+               RequestListener::Connection &c) {
+    ++requests_;
+    auto reply = std::make_shared<Reply>();
+
+    // take references to the blocks under the lock, write them without it
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stored_ > 0) {
+        size_t newest = (next_ + ring_.size() - 1) % ring_.size();
+        size_t oldest = (next_ + ring_.size() - stored_) % ring_.size();
+        for (size_t k = 0; k < stored_; ++k) {
+          const Entry &e = ring_[(oldest + k) % ring_.size()];
+          if (request.eventNumber == 0 ? k + 1 == stored_
+                                       : e.eventNumber == request.eventNumber) {
+            reply->blocks = e.blocks;
+            break;
+          }
+        }
+        reply->header = DataResponseHeader(reply->blocks.size(),
+                                           ring_[oldest].eventNumber,
+                                           ring_[newest].eventNumber);
+      } else {
+        reply->header = DataResponseHeader(0, 0, 0);
+      }
+    }
+
+    const std::vector<Block> &blocks = reply->blocks;
+    reply->sizes.resize(blocks.size());
+    std::vector<iovec> iov;
+    iov.reserve(1 + 2 * blocks.size());
+    iov.push_back(iovec{&reply->header, sizeof(reply->header)});
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      reply->sizes[i] = blocks[i].size;
+      iov.push_back(iovec{&reply->sizes[i], sizeof(uint64_t)});
+      iov.push_back(iovec{const_cast<void *>(blocks[i].data), blocks[i].size});
+    }
+    c.send(std::move(iov), reply);
+  }
+
+  std::vector<Entry> ring_;
+  size_t next_;
+  size_t stored_;
+  std::mutex mutex_;
+  std::atomic<uint64_t> requests_;
+  RequestListener listener_;
+};
+} // namespace ots
+
+#endif // OTSDAQ_DQM_ARTMODULES_DETAIL_DATAREQUESTSERVER_HH
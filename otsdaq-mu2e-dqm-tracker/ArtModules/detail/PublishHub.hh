@@ -0,0 +1,337 @@
+#ifndef OTSDAQ_DQM_ARTMODULES_DETAIL_PUBLISHHUB_HH
+#define OTSDAQ_DQM_ARTMODULES_DETAIL_PUBLISHHUB_HH
+
+// In-process publishing hub shared by the publishers of a process (the DQM
+// modules of an art job, the FEHistoMakerInterface emulator). All of them
+// publishing on the same port get the same hub: one listening socket and one
+// epoll I/O thread, so Occupancy, BeamMonitor and ProtoType no longer fight
+// over listenPort. publish() frames the packet once, as TCPPublishServer does
+// (4-byte big-endian length counting itself), and queues it for every client
+// subscribed to its topic; the I/O thread writes the queues with non-blocking
+// sends. A client whose queue grows beyond maxQueueBytes is disconnected, so a
+// slow display costs its own stream and never stalls the modules or the other
+// displays.
+//
+// Clients that send nothing receive every topic, like TCPPublishServer
+// clients. A client may send lines "subscribe <prefix>" / "unsubscribe
+// <prefix>" to receive only the topics starting with one of its prefixes.
+
+#include "otsdaq/Macros/CoutMacros.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ots {
+class PublishHub {
+public:
+  struct Stats {
+    uint64_t published = 0;  // publish() calls
+    uint64_t queued = 0;     // packets handed to client queues
+    uint64_t sentBytes = 0;
+    uint64_t evicted = 0;    // clients dropped for falling behind
+    size_t clients = 0;
+  };
+
+  // The hub of `port`, created and started by the first module asking for it
+  // and shared until the last one releases it; nullptr if the port cannot be
+  // opened. maxQueueBytes is taken from the first caller.
+  static std::shared_ptr<PublishHub> get(int port,
+                                         size_t maxQueueBytes = 64 << 20) {
+    std::lock_guard<std::mutex> lock(registryMutex_());
+    std::weak_ptr<PublishHub> &entry = registry_()[port];
+    std::shared_ptr<PublishHub> hub = entry.lock();
+    if (!hub) {
+      hub.reset(new PublishHub(port, maxQueueBytes));
+      if (!hub->start_())
+        return nullptr;
+      entry = hub;
+    }
+    return hub;
+  }
+
+  ~PublishHub() { stop_(); }
+  PublishHub(const PublishHub &) = delete;
+  PublishHub &operator=(const PublishHub &) = delete;
+
+  int port() const { return port_; }
+
+  // Never blocks on a client: the packet is copied once and shared by the
+  // queues of all the subscribed clients
+  void publish(const std::string &topic, const void *data, size_t size) {
+    auto packet = std::make_shared<std::string>();
+    packet->resize(4 + size);
+    uint32_t length = htonl(uint32_t(4 + size));
+    std::memcpy(&(*packet)[0], &length, 4);
+    std::memcpy(&(*packet)[4], data, size);
+
+    bool wake = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.published;
+      for (auto &entry : clients_) {
+        auto &client = entry.second;
+        if (client->evict || !client->wants(topic))
+          continue;
+        if (client->queuedBytes + packet->size() > maxQueueBytes_) {
+          client->evict = client->slow = true;
+          wake = true;
+          continue;
+        }
+        client->queue.push_back(packet);
+        client->queuedBytes += packet->size();
+        ++stats_.queued;
+        wake = true;
+      }
+    }
+    if (wake) {
+      uint64_t one = 1;
+      ssize_t n = ::write(wakeFd_, &one, sizeof(one));
+      (void)n;
+    }
+  }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    s.clients = clients_.size();
+    return s;
+  }
+
+private:
+  struct Client {
+    int fd;
+    std::deque<std::shared_ptr<const std::string>> queue;
+    size_t queuedBytes = 0;
+    size_t offset = 0;  // bytes of queue.front() already sent
+    std::vector<std::string> prefixes;
+    std::string line;
+    bool evict = false;  // to be closed by the I/O thread
+    bool slow = false;   // ... for falling behind
+    bool armed = false;  // watched for EPOLLOUT
+
+    bool wants(const std::string &topic) const {
+      if (prefixes.empty())
+        return true;
+      for (const auto &p : prefixes) {
+        if (topic.compare(0, p.size(), p) == 0)
+          return true;
+      }
+      return false;
+    }
+  };
+
+  PublishHub(int port, size_t maxQueueBytes)
+      : port_(port), maxQueueBytes_(maxQueueBytes), listenFd_(-1),
+        wakeFd_(-1), epollFd_(-1), running_(false) {}
+
+  static std::mutex &registryMutex_() {
+    static std::mutex m;
+    return m;
+  }
+  static std::map<int, std::weak_ptr<PublishHub>> &registry_() {
+    static std::map<int, std::weak_ptr<PublishHub>> r;
+    return r;
+  }
+
+  bool start_() {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int on = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port_);
+    if (listenFd_ < 0 ||
+        ::bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+        ::listen(listenFd_, 16) < 0) {
+      __MOUT_ERR__ << "[PublishHub] cannot listen on port " << port_ << ": "
+                   << std::strerror(errno) << std::endl;
+      if (listenFd_ >= 0)
+        ::close(listenFd_);
+      listenFd_ = -1;
+      return false;
+    }
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK);
+    epollFd_ = ::epoll_create1(0);
+    watch_(EPOLL_CTL_ADD, listenFd_, EPOLLIN);
+    watch_(EPOLL_CTL_ADD, wakeFd_, EPOLLIN);
+    running_ = true;
+    thread_ = std::thread(&PublishHub::run_, this);
+    return true;
+  }
+
+  void stop_() {
+    if (!running_)
+      return;
+    running_ = false;
+    thread_.join();
+    for (auto &client : clients_)
+      ::close(client.first);
+    clients_.clear();
+    ::close(listenFd_);
+    ::close(wakeFd_);
+    ::close(epollFd_);
+  }
+
+  void watch_(int op, int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    ::epoll_ctl(epollFd_, op, fd, &event);
+  }
+
+  // Level-triggered epoll: clients are always watched for input (subscription
+  // lines, hang-ups) and for output only while a send could not complete, so
+  // an idle hub costs nothing and a wake-up writes the new packets straight
+  // away, without an extra round through epoll_wait.
+  void run_() {
+    epoll_event events[64];
+    while (running_) {
+      // short timeout so that stop() is honoured promptly
+      int n = ::epoll_wait(epollFd_, events, 64, 100);
+      bool accept = false;
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int i = 0; i < n; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == listenFd_) {
+          accept = true;
+        } else if (fd == wakeFd_) {
+          uint64_t count;
+          ssize_t r = ::read(wakeFd_, &count, sizeof(count));
+          (void)r;
+        } else {
+          auto it = clients_.find(fd);
+          if (it == clients_.end())
+            continue;
+          Client &client = *it->second;
+          if (events[i].events & EPOLLIN)
+            client.evict |= !read_(client);
+          else if (events[i].events & (EPOLLHUP | EPOLLERR))
+            client.evict = true;
+          if (!client.evict && (events[i].events & EPOLLOUT))
+            client.evict = !write_(client);
+        }
+      }
+      if (accept)
+        accept_();
+      for (auto &entry : clients_) {
+        Client &client = *entry.second;
+        if (!client.evict && !client.armed && !client.queue.empty())
+          client.evict = !write_(client);
+        bool arm = !client.evict && !client.queue.empty();
+        if (arm != client.armed) {
+          watch_(EPOLL_CTL_MOD, client.fd, arm ? EPOLLIN | EPOLLOUT : EPOLLIN);
+          client.armed = arm;
+        }
+      }
+      removeEvicted_();
+    }
+  }
+
+  void accept_() {
+    int fd;
+    while ((fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+      auto client = std::make_shared<Client>();
+      client->fd = fd;
+      clients_[fd] = client;
+      watch_(EPOLL_CTL_ADD, fd, EPOLLIN);
+    }
+  }
+
+  // evicted clients are closed here, on the I/O thread only
+  void removeEvicted_() {
+    for (auto it = clients_.begin(); it != clients_.end();) {
+      if (!it->second->evict) {
+        ++it;
+        continue;
+      }
+      if (it->second->slow) {
+        ++stats_.evicted;
+        __MOUT__ << "[PublishHub] port " << port_
+                 << ": dropped a client more than " << maxQueueBytes_
+                 << " bytes behind" << std::endl;
+      }
+      ::close(it->first);  // also removes it from the epoll set
+      it = clients_.erase(it);
+    }
+  }
+
+  // subscription lines; false when the client has gone
+  bool read_(Client &client) {
+    char chunk[512];
+    ssize_t n = ::recv(client.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n == 0)
+      return false;
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    client.line.append(chunk, n);
+    if (client.line.size() > 4096)
+      return false;
+    size_t end;
+    while ((end = client.line.find('\n')) != std::string::npos) {
+      std::istringstream in(client.line.substr(0, end));
+      client.line.erase(0, end + 1);
+      std::string command, prefix;
+      in >> command >> prefix;
+      auto p = std::find(client.prefixes.begin(), client.prefixes.end(), prefix);
+      if (command == "subscribe" && p == client.prefixes.end())
+        client.prefixes.push_back(prefix);
+      else if (command == "unsubscribe" && p != client.prefixes.end())
+        client.prefixes.erase(p);
+    }
+    return true;
+  }
+
+  // as much of the queue as the socket takes; false on a broken connection
+  bool write_(Client &client) {
+    while (!client.queue.empty()) {
+      const std::string &packet = *client.queue.front();
+      ssize_t n = ::send(client.fd, packet.data() + client.offset,
+                         packet.size() - client.offset,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+      stats_.sentBytes += n;
+      client.offset += n;
+      if (client.offset < packet.size())
+        return true;
+      client.queuedBytes -= packet.size();
+      client.offset = 0;
+      client.queue.pop_front();
+    }
+    return true;
+  }
+
+  int port_;
+  size_t maxQueueBytes_;
+  int listenFd_;
+  int wakeFd_;
+  int epollFd_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::map<int, std::shared_ptr<Client>> clients_;  // by socket
+  Stats stats_;
+};
+} // namespace ots
+
+#endif // OTSDAQ_DQM_ARTMODULES_DETAIL_PUBLISHHUB_HH
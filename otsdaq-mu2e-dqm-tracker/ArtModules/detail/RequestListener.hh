@@ -0,0 +1,226 @@
+#ifndef OTSDAQ_DQM_ARTMODULES_DETAIL_REQUESTLISTENER_HH
+#define OTSDAQ_DQM_ARTMODULES_DETAIL_REQUESTLISTENER_HH
+
+// TCP listener running on its own thread: accepts clients on a port and calls
+// a handler with what each client has sent so far. Client sockets are
+// non-blocking, as in PublishHub: every connection has an input buffer the
+// handler consumes complete requests from, and a queue of replies sent as the
+// socket takes them. A client that sends half a request or stops reading its
+// answers only holds its own buffers; neither the listener thread nor stop()
+// ever waits on it. The art thread never waits on a client.
+
+#include "otsdaq/Macros/CoutMacros.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ots {
+class RequestListener {
+public:
+  enum { kMaxInputBytes = 64 << 10 }; // unconsumed input beyond this drops the client
+
+  class Connection {
+  public:
+    explicit Connection(int fd) : fd_(fd), eof_(false) {}
+
+    // received bytes not consumed yet; the handler erases what it has read
+    std::string in;
+
+    // Queue a gathered reply; owner keeps the memory of iov alive until sent
+    void send(std::vector<iovec> iov, std::shared_ptr<const void> owner) {
+      replies_.push_back(Reply{std::move(iov), 0, std::move(owner)});
+    }
+    void send(std::string text) {
+      auto owner = std::make_shared<const std::string>(std::move(text));
+      send({iovec{const_cast<char *>(owner->data()), owner->size()}}, owner);
+    }
+
+    int fd() const { return fd_; }
+    bool sending() const { return !replies_.empty(); }
+
+  private:
+    friend class RequestListener;
+    struct Reply {
+      std::vector<iovec> iov;
+      size_t first; // iov[first] is the next piece to send
+      std::shared_ptr<const void> owner;
+    };
+
+    // as much of the queued replies as the socket takes, resuming after
+    // partial writes; false on a broken connection
+    bool flush_() {
+      while (!replies_.empty()) {
+        Reply &r = replies_.front();
+        while (r.first < r.iov.size()) {
+          msghdr msg{};
+          msg.msg_iov = &r.iov[r.first];
+          msg.msg_iovlen = std::min<size_t>(r.iov.size() - r.first, IOV_MAX);
+          // MSG_NOSIGNAL: a client leaving mid-answer cannot raise SIGPIPE
+          ssize_t n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+          if (n < 0) {
+            if (errno == EINTR)
+              continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+          }
+          while (r.first < r.iov.size() && size_t(n) >= r.iov[r.first].iov_len) {
+            n -= r.iov[r.first].iov_len;
+            ++r.first;
+          }
+          if (n > 0) {
+            r.iov[r.first].iov_base = static_cast<char *>(r.iov[r.first].iov_base) + n;
+            r.iov[r.first].iov_len -= n;
+          }
+        }
+        replies_.pop_front();
+      }
+      return true;
+    }
+
+    // what the socket has; false on an error or when the client sent too
+    // much. A client that shut down its side still gets its answers
+    bool read_() {
+      char chunk[4096];
+      for (;;) {
+        ssize_t n = ::recv(fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (n == 0) {
+          eof_ = true;
+          return true;
+        }
+        if (n < 0) {
+          if (errno == EINTR)
+            continue;
+          return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        in.append(chunk, n);
+        if (in.size() > kMaxInputBytes)
+          return false;
+      }
+    }
+
+    int fd_;
+    bool eof_;
+    std::deque<Reply> replies_;
+  };
+
+  // Called when new input arrived on a connection with no reply pending; it
+  // consumes the complete requests in c.in, queues their answers with
+  // c.send and returns false to close the connection
+  typedef std::function<bool(Connection &c)> Handler;
+
+  RequestListener(int port, Handler handler)
+      : port_(port), handler_(std::move(handler)), listenFd_(-1),
+        running_(false) {}
+  ~RequestListener() { stop(); }
+  RequestListener(const RequestListener &) = delete;
+  RequestListener &operator=(const RequestListener &) = delete;
+
+  bool start() {
+    if (running_)
+      return true;
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port_);
+    if (listenFd_ < 0 ||
+        ::bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+        ::listen(listenFd_, 8) < 0) {
+      __MOUT_ERR__ << "[RequestListener] cannot listen on port " << port_
+                   << ": " << std::strerror(errno) << std::endl;
+      if (listenFd_ >= 0)
+        ::close(listenFd_);
+      listenFd_ = -1;
+      return false;
+    }
+    running_ = true;
+    thread_ = std::thread(&RequestListener::run_, this);
+    return true;
+  }
+
+  void stop() {
+    if (!running_)
+      return;
+    running_ = false;
+    thread_.join();
+    for (auto &c : clients_)
+      ::close(c->fd());
+    clients_.clear();
+    ::close(listenFd_);
+    listenFd_ = -1;
+  }
+
+  int port() const { return port_; }
+  bool running() const { return running_; }
+
+private:
+  void run_() {
+    std::vector<pollfd> fds;
+    while (running_) {
+      fds.clear();
+      fds.push_back(pollfd{listenFd_, POLLIN, 0});
+      for (auto &c : clients_)
+        fds.push_back(pollfd{c->fd(), short((c->eof_ ? 0 : POLLIN) | (c->sending() ? POLLOUT : 0)), 0});
+      // short timeout so that stop() is honoured promptly
+      if (::poll(fds.data(), fds.size(), 100) <= 0)
+        continue;
+
+      for (size_t i = fds.size(); i-- > 1;) {
+        if (fds[i].revents == 0)
+          continue;
+        Connection &c = *clients_[i - 1];
+        bool keep = !(fds[i].revents & (POLLERR | POLLNVAL)) &&
+                    (!(fds[i].revents & POLLIN) || c.read_()) && serve_(c) &&
+                    !(c.eof_ && !c.sending());
+        if (!keep) {
+          ::close(c.fd());
+          clients_.erase(clients_.begin() + (i - 1));
+        }
+      }
+      if (fds[0].revents & POLLIN) {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd >= 0)
+          clients_.push_back(std::unique_ptr<Connection>(new Connection(fd)));
+      }
+    }
+  }
+
+  // send what is queued and, once the replies are out, hand the buffered
+  // input to the handler; a client not reading its answers is not served
+  // further, its unread requests stay in its buffer
+  bool serve_(Connection &c) {
+    if (!c.flush_())
+      return false;
+    if (c.sending() || c.in.empty())
+      return true;
+    if (!handler_(c))
+      return false;
+    return c.flush_();
+  }
+
+  int port_;
+  Handler handler_;
+  int listenFd_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+  std::vector<std::unique_ptr<Connection>> clients_;
+};
+} // namespace ots
+
+#endif // OTSDAQ_DQM_ARTMODULES_DETAIL_REQUESTLISTENER_HH
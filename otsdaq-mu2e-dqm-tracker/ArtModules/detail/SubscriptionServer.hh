@@ -0,0 +1,122 @@
+#ifndef OTSDAQ_DQM_ARTMODULES_DETAIL_SUBSCRIPTIONSERVER_HH
+#define OTSDAQ_DQM_ARTMODULES_DETAIL_SUBSCRIPTIONSERVER_HH
+
+// Request channel for the on-demand (detail) histogram groups. A consumer sends
+// text lines
+//   subscribe <group> [plane [panel]]
+//   unsubscribe <group> [plane [panel]]
+//   list
+// and gets one line back ("ok ..." or "error ..."). A subscription covers a
+// whole group, one plane or one panel and expires after `ttl` seconds unless
+// renewed, so a display that goes away stops the detail stream by itself.
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/RequestListener.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ots {
+class SubscriptionServer {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  SubscriptionServer(int port, const std::vector<std::string> &groups,
+                     int nPlanes, int nPanelsPerPlane, double ttlSeconds)
+      : groups_(groups), nPlanes_(nPlanes), nPanels_(nPanelsPerPlane),
+        ttl_(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(ttlSeconds))),
+        expiry_(groups.size(),
+                std::vector<Clock::time_point>(nPlanes * nPanelsPerPlane)),
+        listener_(port,
+                  [this](RequestListener::Connection &c) { return serve_(c); }) {}
+
+  bool start() { return listener_.start(); }
+  void stop() { listener_.stop(); }
+
+  // Panels of `group` with a live subscription, indexed plane * nPanels +
+  // panel; a snapshot taken once per publish
+  void subscribed(int group, std::vector<bool> &panels) const {
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto &expiry = expiry_[group];
+    panels.resize(expiry.size());
+    for (size_t i = 0; i < expiry.size(); ++i)
+      panels[i] = expiry[i] > now;
+  }
+
+  // handle one request line; public so that it can be driven without a socket
+  std::string request(const std::string &line) {
+    std::istringstream in(line);
+    std::string command, group;
+    in >> command;
+    if (command == "list")
+      return list_();
+    if (command != "subscribe" && command != "unsubscribe")
+      return "error unknown command: " + command;
+    in >> group;
+    auto g = std::find(groups_.begin(), groups_.end(), group);
+    if (g == groups_.end())
+      return "error unknown group: " + group;
+
+    int plane = -1, panel = -1;
+    in >> plane >> panel;
+    if (plane >= nPlanes_ || panel >= nPanels_)
+      return "error no such plane/panel";
+
+    int first = plane < 0 ? 0 : plane * nPanels_ + std::max(panel, 0);
+    int last = plane < 0   ? nPlanes_ * nPanels_
+               : panel < 0 ? (plane + 1) * nPanels_
+                           : first + 1;
+    Clock::time_point until = command == "subscribe"
+                                  ? Clock::now() + ttl_
+                                  : Clock::time_point();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &expiry = expiry_[g - groups_.begin()];
+    std::fill(expiry.begin() + first, expiry.begin() + last, until);
+    return "ok " + command + " " + group + " panels " + std::to_string(first) +
+           "-" + std::to_string(last - 1);
+  }
+
+private:
+  std::string list_() const {
+    std::vector<bool> live;
+    std::string out = "ok";
+    for (size_t g = 0; g < groups_.size(); ++g) {
+      subscribed(g, live);
+      out += " " + groups_[g] + ":" +
+             std::to_string(std::count(live.begin(), live.end(), true));
+    }
+    return out;
+  }
+
+  // answer every complete line the client sent, in one reply
+  bool serve_(RequestListener::Connection &c) {
+    std::string reply;
+    size_t begin = 0, end;
+    while ((end = c.in.find('\n', begin)) != std::string::npos) {
+      reply += request(c.in.substr(begin, end - begin)) + "\n";
+      begin = end + 1;
+    }
+    c.in.erase(0, begin);
+    if (c.in.size() > 4096) // not a line protocol client
+      return false;
+    if (!reply.empty())
+      c.send(std::move(reply));
+    return true;
+  }
+
+  std::vector<std::string> groups_;
+  int nPlanes_;
+  int nPanels_;
+  Clock::duration ttl_;
+  mutable std::mutex mutex_;
+  std::vector<std::vector<Clock::time_point>> expiry_;
+  RequestListener listener_;
+};
+} // namespace ots
+
+#endif // OTSDAQ_DQM_ARTMODULES_DETAIL_SUBSCRIPTIONSERVER_HH
@@ -1,16 +1,44 @@
 #ifndef _ots_FEHistoMakerInterface_h_
 #define _ots_FEHistoMakerInterface_h_
 
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/SyntheticTrackerData.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/detail/PublishHub.hh"
 #include "otsdaq/FECore/FEVInterface.h"
-#include "otsdaq/NetworkUtilities/TCPPublishServer.h"
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <random>
 #include <string>
+#include <vector>
 
 namespace ots {
 
-class FEHistoMakerInterface : public FEVInterface, public TCPPublishServer {
+class FEHistoMakerInterface : public FEVInterface {
 public:
+  // Every update is one packet starting with a FrameHeader. With Source
+  // "normal" (the default) it is followed by `values` doubles drawn from the
+  // emulated distribution; with Source "tracker" the magic is
+  // kTrackerFrameMagic and `values` events follow, each an EventHeader, then
+  // per tracker DTC a uint32_t byte count and the DTC data blocks as read by
+  // mu2e::TrackerFragment.
+  struct FrameHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t values;
+    uint64_t sequence; // per run, starting at 0
+    int64_t timeNs;    // system clock at the update
+  };
+  struct EventHeader {
+    uint64_t eventWindowTag;
+    uint32_t hits;
+    uint16_t fragments;
+    uint16_t reserved;
+  };
+  static const uint32_t kFrameMagic = 0x48454651; // "QFEH" in a little-endian dump
+  static const uint32_t kTrackerFrameMagic = 0x54454651; // "QFET"
+  static const uint16_t kFrameVersion = 1;
+
 public:
   FEHistoMakerInterface(const std::string &interfaceUID,
                         const ConfigurationTree &theXDAQContextConfigTree,
@@ -30,8 +58,24 @@ public:
   void universalWrite(char *address, char *writeValue) override { ; }
 
 private:
+  void makeTrackerFrame_(FrameHeader &header);
+
   std::default_random_engine generator_;
   std::normal_distribution<double> distribution_;
+
+  std::shared_ptr<PublishHub> hub_;
+  std::string topic_;
+  std::chrono::nanoseconds updatePeriod_;
+  unsigned valuesPerFrame_;
+  std::chrono::steady_clock::time_point nextUpdate_;
+  uint64_t sequence_;
+  std::string frame_;
+
+  // synthetic tracker source, nullptr for the normal distribution
+  std::unique_ptr<SyntheticTrackerData<>> tracker_;
+  std::vector<std::vector<uint8_t>> fragments_;
+  uint64_t eventWindowTag_;
+  uint64_t trackerHits_;
 };
 
 } // namespace ots
@@ -3,26 +3,88 @@
 #include "otsdaq/Macros/InterfacePluginMacros.h"
 #include "otsdaq/MessageFacility/MessageFacility.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <thread>
 
 #include <iostream>
 
 using namespace ots;
 
+namespace {
+// value of an optional column of the interface table
+template <class T>
+T optionalValue(const ConfigurationTree &node, const std::string &name,
+                T defaultValue) {
+  try {
+    ConfigurationTree child = node.getNode(name);
+    return child.isDefaultValue() ? defaultValue : child.getValue<T>();
+  } catch (...) {
+    return defaultValue;
+  }
+}
+} // namespace
+
 //========================================================================================================================
 FEHistoMakerInterface::FEHistoMakerInterface(
     const std::string &interfaceUID,
     const ConfigurationTree &theXDAQContextConfigTree,
     const std::string &configurationPath)
     : FEVInterface(interfaceUID, theXDAQContextConfigTree, configurationPath),
-      TCPPublishServer(theXDAQContextConfigTree.getNode(configurationPath)
-                           .getNode("ServerPort")
-                           .getValue<unsigned int>(),
-                       1),
-      distribution_(50, 10) {
+      distribution_(50, 10), sequence_(0), eventWindowTag_(0),
+      trackerHits_(0) {
   std::cout << "[In FEHistoMakerInterface () ] Initiating ..." << std::endl;
-  TCPPublishServer::startAccept();
+  ConfigurationTree node = theXDAQContextConfigTree.getNode(configurationPath);
+
+  // UpdateRateHz defaults to the historical one update every 5 s; at kHz
+  // rates ValuesPerFrame batches the values so consumers see fewer packets
+  double rate = optionalValue<double>(node, "UpdateRateHz", 0.2);
+  updatePeriod_ = std::chrono::nanoseconds(
+      int64_t(1e9 / std::max(rate, 1e-3)));
+  valuesPerFrame_ = std::min(
+      std::max(optionalValue<unsigned>(node, "ValuesPerFrame", 1), 1u),
+      65535u);
+
+  // Source "tracker": synthetic tracker events at EventRateHz, EventsPerFrame
+  // of them per packet; the generator parameters are SyntheticTrackerConfig
+  if (optionalValue<std::string>(node, "Source", "normal") == "tracker") {
+    SyntheticTrackerConfig config;
+    config.occupancy = optionalValue(node, "Occupancy", config.occupancy);
+    config.radialSlope = optionalValue(node, "RadialSlope", config.radialSlope);
+    config.adcSamples = optionalValue(node, "ADCSamples", config.adcSamples);
+    config.pedestalMean =
+        optionalValue(node, "PedestalMean", config.pedestalMean);
+    config.pedestalSpread =
+        optionalValue(node, "PedestalSpread", config.pedestalSpread);
+    config.noise = optionalValue(node, "ADCNoise", config.noise);
+    config.pulseHeight = optionalValue(node, "PulseHeight", config.pulseHeight);
+    config.deadFraction =
+        optionalValue(node, "DeadStrawFraction", config.deadFraction);
+    config.hotFraction =
+        optionalValue(node, "HotStrawFraction", config.hotFraction);
+    config.linksPerDTC =
+        std::max(optionalValue(node, "LinksPerDTC", config.linksPerDTC), 1u);
+    config.seed = optionalValue(node, "Seed", config.seed);
+    tracker_.reset(new SyntheticTrackerData<>(config));
+
+    valuesPerFrame_ = std::min(
+        std::max(optionalValue<unsigned>(node, "EventsPerFrame", 1), 1u),
+        65535u);
+    double eventRate = optionalValue<double>(node, "EventRateHz", 100.);
+    updatePeriod_ = std::chrono::nanoseconds(
+        int64_t(1e9 * valuesPerFrame_ / std::max(eventRate, 1e-3)));
+    std::cout << "[In FEHistoMakerInterface () ] Synthetic tracker source, "
+              << eventRate << " Hz, " << valuesPerFrame_
+              << " events per frame, occupancy " << config.occupancy
+              << std::endl;
+  }
+
+  topic_ = optionalValue<std::string>(node, "Topic", interfaceUID);
+  hub_ = PublishHub::get(
+      node.getNode("ServerPort").getValue<unsigned int>(),
+      optionalValue<unsigned>(node, "MaxClientQueueBytes", 64 << 20));
+  frame_.resize(sizeof(FrameHeader) + valuesPerFrame_ * sizeof(double));
 }
 
 //========================================================================================================================
@@ -46,31 +108,97 @@ void FEHistoMakerInterface::pause(void) {
 //========================================================================================================================
 void FEHistoMakerInterface::resume(void) {
   std::cout << "[In FEHistoMakerInterface () ] Resuming ..." << std::endl;
+  nextUpdate_ = std::chrono::steady_clock::now();
 }
 
 //========================================================================================================================
 void FEHistoMakerInterface::start(std::string runNumber) {
   std::cout << "[In FEHistoMakerInterface () ] Starting ..." << std::endl;
+  sequence_ = 0;
+  eventWindowTag_ = 0;
+  trackerHits_ = 0;
+  nextUpdate_ = std::chrono::steady_clock::now();
 }
 
 //========================================================================================================================
-// The running state is a thread
+// The running state is a thread: one frame per update period, on absolute
+// deadlines so the rate does not drift with the time spent publishing. The hub
+// never blocks, whatever the consumers do.
 bool FEHistoMakerInterface::running(void) {
-  std::cout << "[In FEHistoMakerInterface () ] Running ..." << std::endl;
-  double value = distribution_(generator_);
-  std::string buffer(8, '0');
-  memcpy(&buffer.at(0), &value, sizeof(double));
-  std::cout << __PRETTY_FUNCTION__ << " Value: " << value
-            << " Buffer: " << buffer << std::endl;
-
-  TCPPublishServer::broadcast(buffer);
-  std::this_thread::sleep_for(std::chrono::milliseconds(5000));
+  auto now = std::chrono::steady_clock::now();
+  if (now < nextUpdate_)
+    std::this_thread::sleep_until(nextUpdate_);
+  nextUpdate_ += updatePeriod_;
+  if (nextUpdate_ < now)
+    nextUpdate_ = now + updatePeriod_; // after a stall, resume without a burst
+
+  FrameHeader header{kFrameMagic, kFrameVersion, uint16_t(valuesPerFrame_),
+                     sequence_++,
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count()};
+  if (tracker_) {
+    makeTrackerFrame_(header);
+    if (hub_)
+      hub_->publish(topic_, frame_.data(), frame_.size());
+    return WorkLoop::continueWorkLoop_;
+  }
+  memcpy(&frame_[0], &header, sizeof(header));
+  char *values = &frame_[sizeof(header)];
+  for (unsigned i = 0; i < valuesPerFrame_; ++i) {
+    double value = distribution_(generator_);
+    memcpy(values + i * sizeof(double), &value, sizeof(double));
+  }
+  if (hub_)
+    hub_->publish(topic_, frame_.data(), frame_.size());
   return WorkLoop::continueWorkLoop_; // otherwise it stops!!!!!
 }
 
+//========================================================================================================================
+// Frame of valuesPerFrame_ synthetic events; frame_ and the fragment buffers
+// keep their capacity from frame to frame
+void FEHistoMakerInterface::makeTrackerFrame_(FrameHeader &header) {
+  header.magic = kTrackerFrameMagic;
+  frame_.resize(sizeof(header));
+  for (unsigned e = 0; e < valuesPerFrame_; ++e) {
+    EventHeader event{eventWindowTag_, 0, 0, 0};
+    event.hits = uint32_t(tracker_->makeEvent(eventWindowTag_++, fragments_));
+    event.fragments = uint16_t(fragments_.size());
+    trackerHits_ += event.hits;
+
+    size_t offset = frame_.size();
+    size_t bytes = sizeof(event);
+    for (const auto &fragment : fragments_)
+      bytes += sizeof(uint32_t) + fragment.size();
+    frame_.resize(offset + bytes);
+    char *out = &frame_[offset];
+    memcpy(out, &event, sizeof(event));
+    out += sizeof(event);
+    for (const auto &fragment : fragments_) {
+      uint32_t size = uint32_t(fragment.size());
+      memcpy(out, &size, sizeof(size));
+      if (size > 0)
+        memcpy(out + sizeof(size), fragment.data(), size);
+      out += sizeof(size) + size;
+    }
+  }
+  memcpy(&frame_[0], &header, sizeof(header));
+}
+
 //========================================================================================================================
 void FEHistoMakerInterface::stop(void) {
   std::cout << "[In FEHistoMakerInterface () ] Stoping ..." << std::endl;
+  if (hub_) {
+    PublishHub::Stats stats = hub_->stats();
+    if (tracker_)
+      std::cout << __PRETTY_FUNCTION__ << " " << eventWindowTag_
+                << " synthetic tracker events, " << trackerHits_ << " hits"
+                << std::endl;
+    std::cout << __PRETTY_FUNCTION__ << " " << sequence_ << " frames, "
+              << stats.sentBytes << " bytes sent to " << stats.clients
+              << " clients, " << stats.evicted << " slow clients dropped"
+              << std::endl;
+  }
 }
 
 DEFINE_OTS_INTERFACE(FEHistoMakerInterface)
@@ -0,0 +1,172 @@
+// Encode/decode benchmark of the histogram wire formats: a HistoSender-style
+// map of histograms streamed through TBufferFile, against one BinaryHisto
+// frame read back in place (views) or converted to TH1 objects, and what the
+// codecs built into FrameCompressor make of both.
+//
+// binary_histo_benchmark [--histos N] [--bins N] [--dim 1|2] [--iterations N]
+//                        [--occupancy f]
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/BinaryHisto.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/FrameCompressor.h"
+
+#include <TBufferFile.h>
+#include <TClass.h>
+#include <TH1F.h>
+#include <TH2F.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+  typedef std::map<std::string, std::vector<TH1*>> HistoMap;  // HistoSender::sendHistograms argument
+
+  struct Options {
+    unsigned histos     = 1000;
+    unsigned bins       = 100;
+    unsigned dim        = 1;
+    unsigned iterations = 50;
+    double   occupancy  = 0.3;   // fraction of the bins with entries
+  };
+
+  Options parse(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i + 1 < argc; i += 2) {
+      std::string key = argv[i], value = argv[i + 1];
+      if (key == "--histos") opt.histos = std::stoul(value);
+      else if (key == "--bins") opt.bins = std::stoul(value);
+      else if (key == "--dim") opt.dim = std::stoul(value) == 2 ? 2 : 1;
+      else if (key == "--iterations") opt.iterations = std::max(1ul, std::stoul(value));
+      else if (key == "--occupancy") opt.occupancy = std::stod(value);
+      else {
+	std::fprintf(stderr, "Unknown option %s\n", key.c_str());
+	std::exit(1);
+      }
+    }
+    return opt;
+  }
+
+  double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void report(const char* what, double total, const Options& opt, size_t bytes) {
+    double perFrame = total / opt.iterations;
+    std::printf("%-26s %10.1f us/frame %8.1f ns/histo %9.1f MB/s\n", what, perFrame * 1e6,
+		perFrame * 1e9 / opt.histos, bytes / perFrame * 1e-6);
+  }
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options opt = parse(argc, argv);
+  TH1::AddDirectory(false);
+
+  // histograms shaped like the per-straw DQM ones, split in groups of 96 (one panel)
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> u(0, 1);
+  HistoMap histos;
+  for (unsigned i = 0; i < opt.histos; ++i) {
+    std::string name = "straw_" + std::to_string(i);
+    std::string group = "bench_panel" + std::to_string(i / 96);
+    TH1* h = opt.dim == 2
+	       ? (TH1*)new TH2F(name.c_str(), name.c_str(), opt.bins, 0, 1, opt.bins, 0, 1)
+	       : (TH1*)new TH1F(name.c_str(), name.c_str(), opt.bins, 0, 1);
+    unsigned fills = unsigned(opt.occupancy * opt.bins * (opt.dim == 2 ? opt.bins : 1)) + 1;
+    for (unsigned k = 0; k < fills; ++k) {
+      if (opt.dim == 2) h->Fill(u(rng), u(rng));
+      else h->Fill(u(rng));
+    }
+    histos[group].push_back(h);
+  }
+  TClass* mapClass = TClass::GetClass<HistoMap>();
+
+  // TBufferFile, as HistoSender sends the map
+  size_t rootBytes = 0;
+  auto   start     = std::chrono::steady_clock::now();
+  for (unsigned it = 0; it < opt.iterations; ++it) {
+    TBufferFile buffer(TBuffer::kWrite);
+    buffer.WriteObjectAny(&histos, mapClass);
+    rootBytes = buffer.Length();
+  }
+  double rootEncode = seconds(start);
+
+  TBufferFile encoded(TBuffer::kWrite);
+  encoded.WriteObjectAny(&histos, mapClass);
+  start = std::chrono::steady_clock::now();
+  for (unsigned it = 0; it < opt.iterations; ++it) {
+    TBufferFile buffer(TBuffer::kRead, encoded.Length(), encoded.Buffer(), false);
+    HistoMap*   decoded = static_cast<HistoMap*>(buffer.ReadObjectAny(mapClass));
+    for (auto& group : *decoded) {
+      for (TH1* h : group.second) delete h;
+    }
+    delete decoded;
+  }
+  double rootDecode = seconds(start);
+
+  // BinaryHisto, with the frame buffer reused as TrackerDQM does
+  ots::BinaryHisto::Writer writer;
+  start = std::chrono::steady_clock::now();
+  for (unsigned it = 0; it < opt.iterations; ++it) {
+    writer.begin();
+    for (auto& group : histos) {
+      for (TH1* h : group.second) writer.add(group.first, h);
+    }
+    writer.finish();
+  }
+  double binaryEncode = seconds(start);
+  const std::string& frame = writer.finish();
+
+  double checksum = 0;
+  start = std::chrono::steady_clock::now();
+  for (unsigned it = 0; it < opt.iterations; ++it) {
+    ots::BinaryHisto::Reader reader(frame.data(), frame.size());
+    ots::BinaryHisto::View   view;
+    while (reader.next(view)) checksum += view.content(size_t(1));
+  }
+  double viewDecode = seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (unsigned it = 0; it < opt.iterations; ++it) {
+    ots::BinaryHisto::Reader reader(frame.data(), frame.size());
+    ots::BinaryHisto::View   view;
+    while (reader.next(view)) delete ots::BinaryHisto::toTH1(view);
+  }
+  double binaryDecode = seconds(start);
+
+  std::printf("histograms   %u x %u%s bins, %u iterations\n", opt.histos, opt.bins,
+	      opt.dim == 2 ? "^2" : "", opt.iterations);
+  std::printf("frame bytes  TBufferFile %zu, BinaryHisto %zu\n", rootBytes, frame.size());
+  report("encode TBufferFile", rootEncode, opt, rootBytes);
+  report("encode BinaryHisto", binaryEncode, opt, frame.size());
+  report("decode TBufferFile", rootDecode, opt, rootBytes);
+  report("decode BinaryHisto->TH1", binaryDecode, opt, frame.size());
+  report("decode BinaryHisto views", viewDecode, opt, frame.size());
+  if (checksum < 0) std::printf("%g\n", checksum);  // keep the view loop
+
+  for (const char* codec : {"lz4", "zstd"}) {
+    ots::FrameCompressor compressor(codec, 3, 0, 0);
+    if (!compressor.ok()) continue;
+    for (unsigned it = 0; it < opt.iterations; ++it) {
+      compressor.compress(encoded.Buffer(), encoded.Length());
+      compressor.compress(frame.data(), frame.size());
+    }
+    ots::FrameCompressor::Packet root   = compressor.compress(encoded.Buffer(), encoded.Length());
+    size_t                       rootCompressed = root.size;
+    ots::FrameCompressor::Packet binary = compressor.compress(frame.data(), frame.size());
+    const auto& stats = compressor.stats(compressor.choose(frame.size()));
+    std::printf("%-4s         TBufferFile %zu -> %zu, BinaryHisto %zu -> %zu, %.0f MB/s\n", codec, rootBytes,
+		rootCompressed, frame.size(), binary.size, stats.inBytes * 1e3 / std::max<uint64_t>(1, stats.ns));
+  }
+
+  for (auto& group : histos) {
+    for (TH1* h : group.second) delete h;
+  }
+  return 0;
+}
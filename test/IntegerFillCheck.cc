@@ -0,0 +1,130 @@
+// Check that the integer fill path of TrackerDQM.h (integer_fill counters,
+// FlushPending, MergeReplica) leaves every histogram exactly as the same
+// stream of TH1F::Fill calls does: bin contents, sum of w2, TH1::GetStats sums
+// and entries, compared bit for bit. The streams cover in-range and
+// under/overflow values, histograms that only ever saw under/overflows, a
+// bin filled past 2^24 (where a float bin stops growing), publishes between
+// fills and thread replicas merged in. Exits with 1 on any difference:
+//
+//   integer_fill_check
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQM.h"
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+
+namespace {
+
+  // One histogram filled through integer_fill, its twin through TH1F::Fill
+  struct Pair {
+    ots::TrackerDQMHistoContainer fast, reference;
+    Pair(int nBins, float min, float max, bool sumw2) {
+      ots::MemoryHistoDirectory dir;
+      fast.BookSummaryHistos(dir, "Fast", nBins, min, max);
+      reference.BookSummaryHistos(dir, "Reference", nBins, min, max);
+      if (sumw2) {
+	fast.histograms[0]._Hist->Sumw2();
+	reference.histograms[0]._Hist->Sumw2();
+      }
+    }
+    void fill(int v) {
+      ots::integer_fill(fast.histograms[0], v);
+      reference.histograms[0]._Hist->Fill(v);
+    }
+  };
+
+  int compare(const char* name, Pair& p) {
+    p.fast.FlushPending();
+    const TH1F* x   = p.fast.histograms[0]._Hist;
+    const TH1F* y   = p.reference.histograms[0]._Hist;
+    int         bad = 0;
+    for (int k = 0; k < x->GetNcells(); ++k) {
+      if (x->fArray[k] != y->fArray[k]) {
+	if (++bad <= 5) std::printf("  %s: bin %d %.9g != %.9g\n", name, k, x->fArray[k], y->fArray[k]);
+      }
+    }
+    if (x->GetSumw2N() != y->GetSumw2N()) {
+      ++bad;
+      std::printf("  %s: sumw2 size %d != %d\n", name, x->GetSumw2N(), y->GetSumw2N());
+    } else {
+      for (int k = 0; k < x->GetSumw2N(); ++k) {
+	if (x->GetSumw2()->fArray[k] != y->GetSumw2()->fArray[k]) {
+	  if (++bad <= 5) {
+	    std::printf("  %s: sumw2 %d %.17g != %.17g\n", name, k, x->GetSumw2()->fArray[k],
+			y->GetSumw2()->fArray[k]);
+	  }
+	}
+      }
+    }
+    double sx[4], sy[4];
+    x->GetStats(sx);
+    y->GetStats(sy);
+    for (int k = 0; k < 4; ++k) {
+      if (sx[k] != sy[k]) {
+	++bad;
+	std::printf("  %s: stats[%d] %.17g != %.17g\n", name, k, sx[k], sy[k]);
+      }
+    }
+    if (x->GetEntries() != y->GetEntries()) {
+      ++bad;
+      std::printf("  %s: entries %.17g != %.17g\n", name, x->GetEntries(), y->GetEntries());
+    }
+    std::printf("%-30s %s\n", name, bad ? "FAILED" : "ok");
+    return bad;
+  }
+
+  // `n` values, with a publish (FlushPending) every `publish` fills when set
+  int run(const char* name, Pair&& p, long n, const std::function<int(long)>& value, long publish = 0) {
+    for (long i = 0; i < n; ++i) {
+      p.fill(value(i));
+      if (publish > 0 && (i + 1) % publish == 0) p.fast.FlushPending();
+    }
+    return compare(name, p);
+  }
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(3);
+  auto wide = [&rng](long) { return int(rng() % 2400) - 1200; };
+  int  bad  = 0;
+
+  bad += run("in and out of range", Pair(200, -1000, 1000, false), 1000000, wide);
+  bad += run("with sumw2", Pair(200, -1000, 1000, true), 1000000, wide);
+  bad += run("published while filled", Pair(200, -1000, 1000, true), 1000000, wide, 4096);
+
+  // no weight in range: TH1::GetStats recomputes the sums from the bins
+  bad += run("under/overflow only", Pair(16, 0, 16, false), 100000,
+	     [](long i) { return i % 2 ? -1 - int(i % 7) : 16 + int(i % 5); });
+  bad += run("under/overflow, then in range", Pair(16, 0, 16, true), 200000,
+	     [](long i) { return i < 100000 ? 16 + int(i % 5) : int(i % 16); }, 50000);
+
+  // 2^24 and beyond in bin 6, with and without publishes in between
+  auto saturate = [&rng](long i) { return i % 3 ? 5 : int(rng() % 20) - 2; };
+  bad += run("bin past 2^24", Pair(16, 0, 16, true), 26000000, saturate);
+  bad += run("bin past 2^24, published", Pair(16, 0, 16, false), 26000000, saturate, 1 << 22);
+
+  // two DQM threads filling replicas, merged into a histogram that so far
+  // only saw overflows
+  {
+    Pair                                           p(16, 0, 16, true);
+    std::unique_ptr<ots::TrackerDQMHistoContainer> r1(p.fast.MakeReplica()), r2(p.fast.MakeReplica());
+    for (int i = 0; i < 1000; ++i) p.fill(20);
+    p.fast.FlushPending();
+    for (long i = 0; i < 300000; ++i) {
+      int v = int(rng() % 24) - 4;
+      ots::integer_fill((i % 2 ? r1 : r2)->histograms[0], v);
+      p.reference.histograms[0]._Hist->Fill(v);
+      if (i % 100000 == 99999) {
+	p.fast.MergeReplica(*r1);
+	p.fast.MergeReplica(*r2);
+      }
+    }
+    bad += compare("replicas merged", p);
+  }
+
+  std::printf("%s\n", bad ? "integer fill differs from TH1F::Fill" : "integer fill matches TH1F::Fill");
+  return bad ? 1 : 0;
+}
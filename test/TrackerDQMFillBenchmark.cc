@@ -0,0 +1,139 @@
+// Microbenchmarks of the trackerDQM fill helpers (TrackerDQM.h), each run over
+// batches of 16 to 16384 hits drawn uniformly over the tracker. The linear-search
+// pedestal_fill/panel_fill are kept next to their direct-index replacements
+// straw_fill/panel_index_fill so releases can be compared side by side:
+//
+//   trackerdqm_fill_benchmark --benchmark_out=fill.json --benchmark_out_format=json
+//   compare.py benchmarks old/fill.json new/fill.json   (from google/benchmark tools)
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQM.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+  struct Hit {
+    mu2e::StrawId                  sid;
+    mu2e::TrkTypes::ADCWaveform    adcs;
+  };
+
+  // Reproducible hit sample; the waveforms carry the default 15 ADC samples
+  const std::vector<Hit>& hits(size_t n) {
+    static std::vector<Hit> sample;
+    if (sample.size() < n) {
+      std::mt19937                     rng(12345);
+      std::uniform_int_distribution<>  channel(0, ots::TrackerLayout::kNChannels - 1);
+      std::normal_distribution<double> adc(100., 5.);
+      sample.resize(n);
+      for (auto& hit : sample) {
+	int c   = channel(rng);
+	hit.sid = mu2e::StrawId(ots::TrackerLayout::plane(c), ots::TrackerLayout::panel(c),
+				ots::TrackerLayout::straw(c));
+	hit.adcs.resize(15);
+	for (auto& a : hit.adcs) a = uint16_t(std::max(0., adc(rng)));
+      }
+    }
+    return sample;
+  }
+
+  // Histograms are booked once, detached from any file, in TrackerLayout order
+  struct Containers {
+    ots::TrackerDQMHistoContainer summary, straws, panels;
+    Containers() {
+      ots::MemoryHistoDirectory dir;
+      summary.BookSummaryHistos(dir, "PanelOccupancy", ots::HistoSpecs::kPanelOccupancy);
+      summary.BookSummaryHistos(dir, "PlaneOccupancy", ots::HistoSpecs::kPlaneOccupancy);
+      straws.BookStrawHistos(dir, "Pedestal", ots::HistoSpecs::kPedestal);
+      panels.BookPanelHistos(dir, "Panel", ots::HistoSpecs::kPanel);
+    }
+  };
+
+  Containers& containers() {
+    static Containers c;
+    return c;
+  }
+
+  void HitCounts(benchmark::internal::Benchmark* b) { b->RangeMultiplier(8)->Range(16, 16384); }
+
+  void setItems(benchmark::State& state) {
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+  }
+
+} // namespace
+
+static void BM_pedestal_est(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) benchmark::DoNotOptimize(ots::pedestal_est(sample[i].adcs));
+  }
+  setItems(state);
+}
+BENCHMARK(BM_pedestal_est)->Apply(HitCounts);
+
+static void BM_max_adc(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) benchmark::DoNotOptimize(ots::max_adc(sample[i].adcs));
+  }
+  setItems(state);
+}
+BENCHMARK(BM_max_adc)->Apply(HitCounts);
+
+static void BM_summary_fill(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  auto&       c      = containers();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) ots::summary_fill(&c.summary, sample[i].sid);
+  }
+  setItems(state);
+}
+BENCHMARK(BM_summary_fill)->Apply(HitCounts);
+
+static void BM_pedestal_fill(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  auto&       c      = containers();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i)
+      ots::pedestal_fill(&c.straws, ots::pedestal_est(sample[i].adcs), "Pedestal", sample[i].sid);
+  }
+  setItems(state);
+}
+BENCHMARK(BM_pedestal_fill)->Apply(HitCounts);
+
+static void BM_straw_fill(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  auto&       c      = containers();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i)
+      ots::straw_fill(&c.straws, ots::pedestal_est(sample[i].adcs), sample[i].sid);
+  }
+  setItems(state);
+}
+BENCHMARK(BM_straw_fill)->Apply(HitCounts);
+
+static void BM_panel_fill(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  auto&       c      = containers();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) ots::panel_fill(&c.panels, "Panel", sample[i].sid);
+  }
+  setItems(state);
+}
+BENCHMARK(BM_panel_fill)->Apply(HitCounts);
+
+static void BM_panel_index_fill(benchmark::State& state) {
+  const auto& sample = hits(state.range(0));
+  auto&       c      = containers();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i)
+      ots::panel_index_fill(&c.panels, sample[i].sid.straw(), sample[i].sid);
+  }
+  setItems(state);
+}
+BENCHMARK(BM_panel_index_fill)->Apply(HitCounts);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,221 @@
+// Offline replay benchmark of the trackerDQM decode and fill path.
+// Synthetic tracker DTC fragments are generated up front, then replayed through
+// fill_tracker_fragment exactly as TrackerDQM::analyze does, outside art.
+// With --batch N the hits of N events go through a TrackerHitBatch, as with
+// fillBatchEvents; the cache misses and references of the replay are read
+// from perf_event_open when the kernel allows it (perf_event_paranoid).
+//
+// trackerdqm_replay_benchmark [--events N] [--distinct N] [--occupancy f]
+//                             [--samples N] [--hist pedestals,panels,...]
+//                             [--batch N]
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/SyntheticTrackerData.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQM.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// count every heap allocation made while replaying
+static std::atomic<uint64_t> gAllocations{0};
+
+void* operator new(size_t size) {
+  ++gAllocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+  struct Options {
+    unsigned                 events   = 10000;
+    unsigned                 distinct = 100;
+    unsigned                 batch    = 1;
+    ots::SyntheticTrackerConfig data;
+    std::vector<std::string> histType = {"pedestals", "panels"};
+  };
+
+  Options parse(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i + 1 < argc; i += 2) {
+      std::string key = argv[i], value = argv[i + 1];
+      if (key == "--events") opt.events = std::stoul(value);
+      else if (key == "--distinct") opt.distinct = std::max(1ul, std::stoul(value));
+      else if (key == "--occupancy") opt.data.occupancy = std::stod(value);
+      else if (key == "--samples") opt.data.adcSamples = std::stoul(value);
+      else if (key == "--batch") opt.batch = std::max(1ul, std::stoul(value));
+      else if (key == "--hist") {
+	opt.histType.clear();
+	std::stringstream ss(value);
+	for (std::string name; std::getline(ss, name, ',');) opt.histType.push_back(name);
+      } else {
+	std::fprintf(stderr, "Unknown option %s\n", key.c_str());
+	std::exit(1);
+      }
+    }
+    return opt;
+  }
+
+  // hardware counter of this thread, user space only; -1 when unavailable
+  class PerfCounter {
+  public:
+    explicit PerfCounter(uint64_t config) {
+      perf_event_attr attr{};
+      attr.type           = PERF_TYPE_HARDWARE;
+      attr.size           = sizeof(attr);
+      attr.config         = config;
+      attr.disabled       = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~PerfCounter() {
+      if (fd_ >= 0) close(fd_);
+    }
+    bool ok() const { return fd_ >= 0; }
+    void start() {
+      if (fd_ < 0) return;
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t stop() {
+      uint64_t count = 0;
+      if (fd_ < 0) return 0;
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) return 0;
+      return count;
+    }
+
+  private:
+    long fd_;
+  };
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options opt = parse(argc, argv);
+  ots::MemoryHistoDirectory dir;
+
+  ots::TrackerDQMHistoContainer summary, pedestal, panel, tdc, tdcPanel, tot, totPanel;
+  std::vector<uint16_t>         driftChannels;
+  std::vector<float>            driftValues;
+  ots::PedestalDriftTracker     drift(ots::TrackerLayout::kNChannels, 0.01, 5., 200);
+  ots::StrawHealthMonitor       health(ots::TrackerLayout::kNChannels, ots::TrackerLayout::kStraws,
+				       1000, 5., 5., 10.);
+  ots::DataIntegrityMonitor     integrity;
+  ots::TrackerHitSinks          sinks;
+  ots::TrackerHitBatch          batch(opt.batch);
+
+  summary.BookSummaryHistos(dir, "PanelOccupancy", ots::HistoSpecs::kPanelOccupancy);
+  summary.BookSummaryHistos(dir, "PlaneOccupancy", ots::HistoSpecs::kPlaneOccupancy);
+  sinks.summary = &summary;
+  for (const auto& name : opt.histType) {
+    if (name == "pedestals") {
+      pedestal.BookStrawHistos(dir, "Pedestal", ots::HistoSpecs::kPedestal);
+      sinks.pedestal = &pedestal;
+    } else if (name == "panels") {
+      panel.BookPanelHistos(dir, "Panel", ots::HistoSpecs::kPanel);
+      sinks.panel = &panel;
+    } else if (name == "tdc") {
+      tdc.BookStrawHistos(dir, "DeltaT", ots::HistoSpecs::kDeltaT);
+      tdcPanel.BookPanelHistos(dir, "PanelDeltaT", ots::HistoSpecs::kPanelDeltaT);
+      sinks.tdc = &tdc;
+      sinks.tdcPanel = &tdcPanel;
+    } else if (name == "tot") {
+      tot.BookStrawHistos(dir, "TOT", ots::HistoSpecs::kTot);
+      totPanel.BookPanelHistos(dir, "PanelTOT", ots::HistoSpecs::kPanelTot);
+      sinks.tot = &tot;
+      sinks.totPanel = &totPanel;
+    } else if (name == "pedestalDrift") {
+      sinks.driftChannels = &driftChannels;
+      sinks.driftValues = &driftValues;
+    } else if (name == "strawHealth") {
+      sinks.strawHealth = &health;
+    } else if (name != "integrity") {
+      std::fprintf(stderr, "Unrecognized histogram type: %s\n", name.c_str());
+      return 1;
+    }
+  }
+  bool doIntegrity = std::find(opt.histType.begin(), opt.histType.end(), "integrity") != opt.histType.end();
+  if (opt.batch > 1) {
+    batch.bind(sinks);
+    sinks.batch = &batch;
+  }
+
+  // generate the events up front so that the replay only measures trackerDQM
+  ots::SyntheticTrackerData<> generator(opt.data);
+  std::vector<std::vector<std::vector<uint8_t>>> events(opt.distinct);
+  size_t generatedHits = 0, generatedBytes = 0;
+  for (unsigned i = 0; i < opt.distinct; ++i) {
+    generatedHits += generator.makeEvent(i, events[i]);
+    for (const auto& f : events[i]) generatedBytes += f.size();
+  }
+  driftChannels.reserve(2 * generatedHits / opt.distinct + 1024);
+  driftValues.reserve(2 * generatedHits / opt.distinct + 1024);
+
+  ots::LatencyHistogram latency;
+  uint64_t              decodeTicks = 0;
+  size_t                hits        = 0;
+  PerfCounter           misses(PERF_COUNT_HW_CACHE_MISSES);
+  PerfCounter           references(PERF_COUNT_HW_CACHE_REFERENCES);
+  uint64_t              allocStart  = gAllocations;
+  auto                  start       = std::chrono::steady_clock::now();
+  misses.start();
+  references.start();
+
+  for (unsigned evt = 0; evt < opt.events; ++evt) {
+    ots::ScopedTimer timer(&latency);
+    if (doIntegrity) integrity.beginEvent();
+    for (const auto& payload : events[evt % opt.distinct]) {
+      if (doIntegrity) integrity.addFragment(payload.size());
+      mu2e::TrackerFragment cc(payload.data(), payload.size());
+      hits += ots::fill_tracker_fragment(cc, sinks, doIntegrity ? &integrity : nullptr, &decodeTicks);
+    }
+    if (doIntegrity) integrity.endEvent();
+    if (sinks.driftChannels) {
+      drift.update(driftChannels, driftValues);
+      driftChannels.clear();
+      driftValues.clear();
+    }
+    if (sinks.strawHealth) health.endEvent();
+    if (sinks.batch && batch.endEvent()) batch.flush();
+  }
+  if (sinks.batch) batch.flush();
+
+  uint64_t cacheMisses = misses.stop();
+  uint64_t cacheRefs   = references.stop();
+  double   seconds     = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  uint64_t allocations = gAllocations - allocStart;
+
+  std::printf("events            %u (%u distinct, %.1f hits/event, %.1f kB/event)\n", opt.events,
+	      opt.distinct, double(generatedHits) / opt.distinct, generatedBytes / 1024. / opt.distinct);
+  std::printf("events/s          %.1f\n", opt.events / seconds);
+  std::printf("hits/s            %.1f\n", hits / seconds);
+  std::printf("decode fraction   %.3f\n", ots::DQMClock::toNs(decodeTicks) * 1e-9 / seconds);
+  std::printf("allocations/event %.1f\n", double(allocations) / opt.events);
+  std::printf("fill batch        %u events\n", opt.batch);
+  if (misses.ok() && hits > 0) {
+    std::printf("cache misses/hit  %.2f\n", double(cacheMisses) / hits);
+    std::printf("cache miss ratio  %.3f\n", cacheRefs ? double(cacheMisses) / cacheRefs : 0.);
+  } else {
+    std::printf("cache misses/hit  n/a (perf_event_open unavailable)\n");
+  }
+  std::printf("latency mean      %.0f ns\n", latency.meanNs());
+  std::printf("latency p50       %.0f ns\n", latency.quantile(0.50));
+  std::printf("latency p99       %.0f ns\n", latency.quantile(0.99));
+  std::printf("latency max       %llu ns\n", (unsigned long long)latency.maxNs());
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Check that fill_tracker_hit (TrackerDQM.h) fills a hit only when its straw id
+// is inside the tracker. The StrawId bit fields hold planes, panels and straws
+// beyond the detector (up to 63, 7 and 127); such a hit from corrupt DTC data
+// must be refused without touching any sink, directly or through a
+// TrackerHitBatch, and counted by the integrity monitor. Exits with 1 on a
+// failure:
+//
+//   tracker_hit_check
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/TrackerDQM.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+  // the fields of a TrackerDataPacket that fill_tracker_hit reads
+  struct Packet {
+    uint16_t StrawIndex;
+    uint8_t  TOT0, TOT1;
+    uint16_t TDC0() const { return 1200; }
+    uint16_t TDC1() const { return 1100; }
+  };
+
+  struct Sinks {
+    ots::TrackerDQMHistoContainer summary, pedestal, panel, tdc, tdcPanel, tot, totPanel;
+    std::vector<uint16_t>         driftChannels;
+    std::vector<float>            driftValues;
+    ots::StrawHealthMonitor       health{ots::TrackerLayout::kNChannels, ots::TrackerLayout::kStraws,
+					   1000, 5., 5., 10.};
+    ots::TrackerHitBatch          batch{4};
+    ots::TrackerHitSinks          sinks;
+
+    explicit Sinks(bool batched) {
+      ots::MemoryHistoDirectory dir;
+      summary.BookSummaryHistos(dir, "PanelOccupancy", ots::HistoSpecs::kPanelOccupancy);
+      summary.BookSummaryHistos(dir, "PlaneOccupancy", ots::HistoSpecs::kPlaneOccupancy);
+      pedestal.BookStrawHistos(dir, "Pedestal", ots::HistoSpecs::kPedestal);
+      panel.BookPanelHistos(dir, "Panel", ots::HistoSpecs::kPanel);
+      tdc.BookStrawHistos(dir, "DeltaT", ots::HistoSpecs::kDeltaT);
+      tdcPanel.BookPanelHistos(dir, "PanelDeltaT", ots::HistoSpecs::kPanelDeltaT);
+      tot.BookStrawHistos(dir, "TOT", ots::HistoSpecs::kTot);
+      totPanel.BookPanelHistos(dir, "PanelTOT", ots::HistoSpecs::kPanelTot);
+      sinks.summary       = &summary;
+      sinks.pedestal      = &pedestal;
+      sinks.panel         = &panel;
+      sinks.tdc           = &tdc;
+      sinks.tdcPanel      = &tdcPanel;
+      sinks.tot           = &tot;
+      sinks.totPanel      = &totPanel;
+      sinks.driftChannels = &driftChannels;
+      sinks.driftValues   = &driftValues;
+      sinks.strawHealth   = &health;
+      if (batched) {
+	batch.bind(sinks);
+	sinks.batch = &batch;
+      }
+    }
+
+    // entries of every histogram, after the batch and the pending fills
+    double entries() {
+      if (sinks.batch) batch.flush();
+      double n = 0;
+      for (auto* c : {&summary, &pedestal, &panel, &tdc, &tdcPanel, &tot, &totPanel}) {
+	c->FlushPending();
+	for (const auto& h : c->histograms) n += h._Hist->GetEntries();
+      }
+      return n;
+    }
+  };
+
+  int run(bool batched) {
+    Sinks                              s(batched);
+    ots::DataIntegrityMonitor          integrity;
+    const mu2e::TrkTypes::ADCWaveform  adcs(15, 100);
+    const int                          nPlanes = ots::TrackerLayout::kPlanes, nPanels = ots::TrackerLayout::kPanels,
+			               nStraws = ots::TrackerLayout::kStraws;
+    int bad = 0;
+
+    // the last straw of the tracker, then ids just past each dimension and
+    // the largest the bit fields allow
+    Packet good{mu2e::StrawId(nPlanes - 1, nPanels - 1, nStraws - 1).asUint16(), 10, 12};
+    if (!ots::fill_tracker_hit(s.sinks, good, adcs)) {
+      ++bad;
+      std::printf("  valid straw refused\n");
+    }
+    double filled = s.entries();
+
+    const mu2e::StrawId outside[] = {mu2e::StrawId(nPlanes, 0, 0), mu2e::StrawId(0, nPanels, 0),
+				     mu2e::StrawId(0, 0, nStraws), mu2e::StrawId(63, 7, 127)};
+    for (const auto& sid : outside) {
+      Packet hit{sid.asUint16(), 10, 12};
+      if (ots::fill_tracker_hit(s.sinks, hit, adcs)) {
+	++bad;
+	std::printf("  straw id 0x%04x filled\n", unsigned(sid.asUint16()));
+      } else {
+	integrity.malformedHit();
+      }
+    }
+    if (s.entries() != filled || s.driftChannels.size() != 1) {
+      ++bad;
+      std::printf("  sinks changed by refused hits: %g entries instead of %g, %zu drift hits\n", s.entries(),
+		  filled, s.driftChannels.size());
+    }
+    if (integrity.malformedHits() != 4) {
+      ++bad;
+      std::printf("  %llu malformed hits counted instead of 4\n", (unsigned long long)integrity.malformedHits());
+    }
+    std::printf("%-30s %s\n", batched ? "batched fills" : "direct fills", bad ? "FAILED" : "ok");
+    return bad;
+  }
+
+} // namespace
+
+int main() {
+  int bad = run(false) + run(true);
+  std::printf("%s\n", bad ? "straw ids outside the tracker are filled" : "straw ids outside the tracker are refused");
+  return bad ? 1 : 0;
+}
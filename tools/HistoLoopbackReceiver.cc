@@ -0,0 +1,289 @@
+#include "tools/HistoLoopbackReceiver.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/BinaryHisto.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/FrameCompressor.h"
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/PublishStamp.h"
+
+#include <TBufferFile.h>
+#include <TClass.h>
+#include <TH1.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+  typedef std::map<std::string, std::vector<TH1*>> HistoMap;  // HistoSender::sendHistograms argument
+
+  const size_t kHeaderBytes = 4;
+}
+
+ots::HistoLoopbackReceiver::HistoLoopbackReceiver(const Config& config)
+  : config_(config), listenFd_(-1), lastArrivalTicks_(0) {}
+
+ots::HistoLoopbackReceiver::~HistoLoopbackReceiver() { close(); }
+
+bool ots::HistoLoopbackReceiver::open() {
+  close();
+  if (config_.mode == kListen) {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(config_.port);
+    if (listenFd_ < 0 || ::bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(listenFd_, 8) < 0) {
+      std::cerr << "HistoLoopbackReceiver: cannot listen on port " << config_.port << ": "
+		<< std::strerror(errno) << std::endl;
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  addrinfo  hints{};
+  addrinfo* res = nullptr;
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (::getaddrinfo(config_.host.c_str(), std::to_string(config_.port).c_str(), &hints, &res) != 0) {
+    std::cerr << "HistoLoopbackReceiver: cannot resolve " << config_.host << std::endl;
+    return false;
+  }
+  int fd = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  int rc = fd < 0 ? -1 : ::connect(fd, res->ai_addr, res->ai_addrlen);
+  ::freeaddrinfo(res);
+  if (rc < 0) {
+    std::cerr << "HistoLoopbackReceiver: cannot connect to " << config_.host << ":" << config_.port
+	      << ": " << std::strerror(errno) << std::endl;
+    if (fd >= 0) ::close(fd);
+    return false;
+  }
+  int on = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  connections_.push_back(Connection{fd, {}});
+  return true;
+}
+
+void ots::HistoLoopbackReceiver::close() {
+  for (auto& c : connections_) ::close(c.fd);
+  connections_.clear();
+  if (listenFd_ >= 0) ::close(listenFd_);
+  listenFd_ = -1;
+}
+
+size_t ots::HistoLoopbackReceiver::run(double seconds, uint64_t maxMessages) {
+  uint64_t start    = stats_.messages;
+  auto     deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+
+  while (std::chrono::steady_clock::now() < deadline &&
+	 (maxMessages == 0 || stats_.messages - start < maxMessages)) {
+    if (config_.mode == kConnect && connections_.empty()) break;
+
+    std::vector<pollfd> fds;
+    if (listenFd_ >= 0) fds.push_back(pollfd{listenFd_, POLLIN, 0});
+    for (const auto& c : connections_) fds.push_back(pollfd{c.fd, POLLIN, 0});
+
+    int left = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+		     deadline - std::chrono::steady_clock::now()).count());
+    int n = ::poll(fds.data(), fds.size(), std::max(0, std::min(left, 100)));
+    if (n <= 0) continue;
+
+    size_t first = 0;
+    if (listenFd_ >= 0) {
+      first = 1;
+      if (fds[0].revents & POLLIN) {
+	int fd = ::accept(listenFd_, nullptr, nullptr);
+	if (fd >= 0) {
+	  int on = 1;
+	  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	  connections_.push_back(Connection{fd, {}});
+	}
+      }
+    }
+    // iterate backwards so closed connections can be erased in place
+    for (size_t i = fds.size(); i-- > first;) {
+      if (fds[i].revents == 0) continue;
+      Connection& c = connections_[i - first];
+      if (!readFrom(c, maxMessages ? maxMessages - (stats_.messages - start) : 0)) {
+	::close(c.fd);
+	connections_.erase(connections_.begin() + (i - first));
+      }
+    }
+  }
+  return stats_.messages - start;
+}
+
+// Append what is available on the socket and process every complete frame.
+// Returns false when the peer closed the connection or sent a bad frame.
+bool ots::HistoLoopbackReceiver::readFrom(Connection& c, uint64_t maxMessages) {
+  char    chunk[65536];
+  ssize_t n = ::recv(c.fd, chunk, sizeof(chunk), 0);
+  if (n <= 0) return false;
+  c.buffer.insert(c.buffer.end(), chunk, chunk + n);
+
+  size_t   offset = 0;
+  uint64_t read   = 0;
+  while (c.buffer.size() - offset >= kHeaderBytes && (maxMessages == 0 || read < maxMessages)) {
+    uint32_t length;
+    std::memcpy(&length, &c.buffer[offset], kHeaderBytes);
+    length = ntohl(length);
+    if (config_.lengthIncludesHeader) {
+      if (length < kHeaderBytes) return false;
+      length -= kHeaderBytes;
+    }
+    if (length > config_.maxMessageBytes) {
+      std::cerr << "HistoLoopbackReceiver: frame of " << length << " bytes, dropping the connection" << std::endl;
+      return false;
+    }
+    if (c.buffer.size() - offset - kHeaderBytes < length) break;
+    process(&c.buffer[offset + kHeaderBytes], length);
+    offset += kHeaderBytes + length;
+    ++read;
+  }
+  c.buffer.erase(c.buffer.begin(), c.buffer.begin() + offset);
+  return true;
+}
+
+void ots::HistoLoopbackReceiver::process(const char* data, size_t size) {
+  uint64_t now = DQMClock::ticks();
+  int64_t  receivedNs = PublishStamp::nowNs();
+  if (stats_.messages > 0) stats_.interArrival.record(DQMClock::toNs(now - lastArrivalTicks_));
+  lastArrivalTicks_ = now;
+
+  stats_.minBytes = stats_.messages == 0 ? size : std::min<uint64_t>(stats_.minBytes, size);
+  stats_.maxBytes = std::max<uint64_t>(stats_.maxBytes, size);
+  stats_.bytes   += size;
+  ++stats_.messages;
+
+  // sizes above are on the wire
+  if (FrameCompressor::isCompressed(data, size)) {
+    ++stats_.compressed;
+    bool inflated;
+    {
+      ScopedTimer timer(&stats_.inflate);
+      inflated = FrameCompressor::decompress(data, size, inflated_, config_.maxMessageBytes);
+    }
+    if (!inflated) {
+      ++stats_.decodeFailures;
+      return;
+    }
+    stats_.inflatedBytes += inflated_.size();
+    data = inflated_.data();
+    size = inflated_.size();
+  }
+
+  // a BinaryHisto frame (TrackerDQM wireFormat binary) is read in place
+  if (BinaryHisto::Reader::isFrame(data, size)) {
+    BinaryHisto::Reader reader(data, size);
+    BinaryHisto::View   view;
+    size_t              records = 0;
+    {
+      ScopedTimer timer(&stats_.deserialize);
+      while (reader.next(view)) {
+	++records;
+	++stats_.objects;
+	std::string name = view.name();
+	size_t      n    = std::char_traits<char>::length(PublishStamp::kSuffix);
+	if (view.nx() == 3 && name.size() >= n && name.compare(name.size() - n, n, PublishStamp::kSuffix) == 0) {
+	  PublishStamp stamp;
+	  stamp.sequence = uint64_t(view.content(size_t(1)));
+	  stamp.sendNs   = int64_t(view.content(size_t(2))) * 1000000000 + int64_t(view.content(size_t(3)));
+	  accountStamp(name, stamp, receivedNs);
+	}
+      }
+    }
+    if (!reader.valid() || records != reader.records()) ++stats_.decodeFailures;
+    ++stats_.perClass["BinaryHisto"];
+    return;
+  }
+
+  // otherwise the payload is either one TObject (TCPPublishServer modules) or a
+  // whole HistoSender map: read the class tag first, then the object of that class
+  void*   object = nullptr;
+  TClass* cl     = nullptr;
+  {
+    ScopedTimer timer(&stats_.deserialize);
+    TBufferFile buffer(TBuffer::kRead, int(size), const_cast<char*>(data), false);
+    cl = buffer.ReadClass();
+    if (cl != nullptr && cl != (TClass*)-1) {
+      buffer.SetBufferOffset(0);
+      object = buffer.ReadObjectAny(cl);
+    }
+  }
+  if (object == nullptr) {
+    ++stats_.decodeFailures;
+    return;
+  }
+  ++stats_.perClass[cl->GetName()];
+
+  if (cl == TClass::GetClass<HistoMap>()) {
+    HistoMap* histos = static_cast<HistoMap*>(object);
+    for (auto& dir : *histos) {
+      for (TH1* h : dir.second) {
+	account(h, receivedNs);
+	delete h;
+      }
+    }
+  } else if (cl->InheritsFrom(TObject::Class())) {
+    account(static_cast<TObject*>(cl->DynamicCast(TObject::Class(), object)), receivedNs);
+  }
+  cl->Destructor(object);
+}
+
+void ots::HistoLoopbackReceiver::account(const TObject* obj, int64_t receivedNs) {
+  ++stats_.objects;
+  PublishStamp stamp;
+  if (PublishStamp::read(obj, stamp)) accountStamp(obj->GetName(), stamp, receivedNs);
+}
+
+void ots::HistoLoopbackReceiver::accountStamp(const std::string& name, const PublishStamp& stamp,
+					      int64_t receivedNs) {
+  ++stats_.stamps;
+  stats_.endToEnd.record(uint64_t(std::max<int64_t>(0, receivedNs - stamp.sendNs)));
+  auto last = lastSequence_.find(name);
+  if (last != lastSequence_.end() && stamp.sequence > last->second + 1) {
+    stats_.lostPublishes += stamp.sequence - last->second - 1;
+  }
+  lastSequence_[name] = stamp.sequence;
+}
+
+void ots::HistoLoopbackReceiver::resetStats() {
+  stats_ = Stats();
+}
+
+void ots::HistoLoopbackReceiver::print(std::ostream& out) const {
+  const Stats& s = stats_;
+  out << "messages           " << s.messages << " (" << s.objects << " objects, " << s.decodeFailures
+      << " undecodable)\n";
+  out << "message bytes      min " << s.minBytes << " mean " << (s.messages ? s.bytes / s.messages : 0)
+      << " max " << s.maxBytes << "\n";
+  if (s.compressed > 0) {
+    out << "compressed         " << s.compressed << " messages, " << s.inflatedBytes << " bytes once inflated\n";
+  }
+  auto quantiles = [&out](const char* name, const LatencyHistogram& h) {
+    out << std::left << std::setw(19) << name << std::right << "p50 " << h.quantile(0.5) / 1e3
+	<< " us  p99 " << h.quantile(0.99) / 1e3 << " us  max " << h.maxNs() / 1e3 << " us\n";
+  };
+  quantiles("deserialize", s.deserialize);
+  if (s.compressed > 0) quantiles("decompress", s.inflate);
+  quantiles("inter-arrival", s.interArrival);
+  if (s.stamps > 0) {
+    quantiles("end-to-end", s.endToEnd);
+    out << "publishes          " << s.stamps << " received, " << s.lostPublishes << " lost ("
+	<< 100. * s.lostPublishes / double(s.stamps + s.lostPublishes) << " %)\n";
+  } else {
+    out << "end-to-end         no PublishStamp received, enable publishStamp in the publisher\n";
+  }
+  for (const auto& c : s.perClass) out << "  " << c.first << ": " << c.second << "\n";
+}
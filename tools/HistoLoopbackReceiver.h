@@ -0,0 +1,101 @@
+// Local stand-in for the receivers of the DQM histogram streams, to measure
+// publishing on one machine. It either listens for the HistoSender stream
+// (TrackerDQM address/port) or connects to a TCPPublishServer (Occupancy
+// listenPort), decompresses FrameCompressor packets, decodes the TBufferFile
+// or BinaryHisto payloads and keeps per-message statistics: size, deserialization time, inter-arrival time and,
+// when the publisher sends PublishStamp histograms, the end-to-end latency and
+// the lost publishes.
+#ifndef _HistoLoopbackReceiver_h_
+#define _HistoLoopbackReceiver_h_
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/DQMTimers.h"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class TObject;
+
+namespace ots {
+
+  struct PublishStamp;
+
+  class HistoLoopbackReceiver {
+  public:
+    enum Mode { kListen, kConnect };
+
+    struct Config {
+      Mode        mode                 = kListen;
+      std::string host                 = "127.0.0.1";  // kConnect only
+      int         port                 = 6000;
+      // otsdaq TCP packets carry a 4-byte big-endian length that counts the header itself
+      bool        lengthIncludesHeader = true;
+      // bound on a frame, both as received and once decompressed
+      uint32_t    maxMessageBytes      = 256u << 20;
+    };
+
+    struct Stats {
+      uint64_t messages       = 0;
+      uint64_t bytes          = 0;
+      uint64_t minBytes       = 0;
+      uint64_t maxBytes       = 0;
+      uint64_t objects        = 0;  // histograms, after unpacking HistoSender maps
+      uint64_t decodeFailures = 0;
+      uint64_t compressed     = 0;  // FrameCompressor packets
+      uint64_t inflatedBytes  = 0;  // their size once decompressed
+      uint64_t stamps         = 0;
+      uint64_t lostPublishes  = 0;  // gaps in the PublishStamp sequence numbers
+      LatencyHistogram              deserialize;
+      LatencyHistogram              inflate;
+      LatencyHistogram              interArrival;
+      LatencyHistogram              endToEnd;
+      std::map<std::string, uint64_t> perClass;
+    };
+
+    explicit HistoLoopbackReceiver(const Config& config);
+    ~HistoLoopbackReceiver();
+    HistoLoopbackReceiver(const HistoLoopbackReceiver&) = delete;
+    HistoLoopbackReceiver& operator=(const HistoLoopbackReceiver&) = delete;
+
+    // bind and listen, or connect; false (and a message on stderr) on failure
+    bool open();
+    void close();
+
+    // receive for at most `seconds`, or until maxMessages (0 = no limit) have
+    // been read or the peer closed a kConnect stream; returns the messages read
+    size_t run(double seconds, uint64_t maxMessages = 0);
+
+    // deserialize and account one payload; usable on captured buffers
+    void process(const char* data, size_t size);
+
+    bool connected() const { return !connections_.empty(); }
+
+    const Stats& stats() const { return stats_; }
+    // start new statistics; the publish sequence numbers are kept to count losses across resets
+    void         resetStats();
+    void         print(std::ostream& out) const;
+
+  private:
+    struct Connection {
+      int               fd;
+      std::vector<char> buffer;
+    };
+
+    bool readFrom(Connection& c, uint64_t maxMessages);
+    void account(const TObject* obj, int64_t receivedNs);
+    void accountStamp(const std::string& name, const PublishStamp& stamp, int64_t receivedNs);
+
+    Config                          config_;
+    int                             listenFd_;
+    std::vector<Connection>         connections_;
+    Stats                           stats_;
+    uint64_t                        lastArrivalTicks_;
+    std::map<std::string, uint64_t> lastSequence_;
+    std::string                     inflated_;
+  };
+
+} // namespace ots
+
+#endif
@@ -0,0 +1,67 @@
+// Receive DQM histogram streams over loopback and report their size,
+// deserialization time, inter-arrival time, end-to-end latency and losses.
+//
+//   histo_loopback_receiver --listen 6000                 (TrackerDQM: address 127.0.0.1, port 6000)
+//   histo_loopback_receiver --connect 127.0.0.1:6000      (Occupancy: listenPort 6000)
+//
+// Other options: --seconds S (default 60), --messages N, --report S (periodic
+// report interval), --length-excludes-header (frame length without its 4 bytes)
+
+#include "tools/HistoLoopbackReceiver.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+  ots::HistoLoopbackReceiver::Config config;
+  double   seconds     = 60.;
+  double   report      = 0.;
+  uint64_t maxMessages = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg  = argv[i];
+    bool        more = i + 1 < argc;
+    if (arg == "--listen" && more) {
+      config.mode = ots::HistoLoopbackReceiver::kListen;
+      config.port = std::atoi(argv[++i]);
+    } else if (arg == "--connect" && more) {
+      std::string target = argv[++i];
+      size_t      colon  = target.rfind(':');
+      config.mode = ots::HistoLoopbackReceiver::kConnect;
+      config.host = target.substr(0, colon);
+      config.port = std::atoi(target.substr(colon + 1).c_str());
+    } else if (arg == "--seconds" && more) {
+      seconds = std::atof(argv[++i]);
+    } else if (arg == "--messages" && more) {
+      maxMessages = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--report" && more) {
+      report = std::atof(argv[++i]);
+    } else if (arg == "--length-excludes-header") {
+      config.lengthIncludesHeader = false;
+    } else {
+      std::cerr << "usage: " << argv[0] << " (--listen PORT | --connect HOST:PORT) [--seconds S]"
+		<< " [--messages N] [--report S] [--length-excludes-header]" << std::endl;
+      return 1;
+    }
+  }
+
+  ots::HistoLoopbackReceiver receiver(config);
+  if (!receiver.open()) return 1;
+
+  double   interval = report > 0 ? std::min(report, seconds) : seconds;
+  uint64_t received = 0;
+  for (double elapsed = 0; elapsed < seconds; elapsed += interval) {
+    received += receiver.run(interval, maxMessages ? maxMessages - received : 0);
+    if (report > 0) {
+      receiver.print(std::cout);
+      std::cout << std::endl;
+      receiver.resetStats();
+    }
+    if (maxMessages && received >= maxMessages) break;
+    if (config.mode == ots::HistoLoopbackReceiver::kConnect && !receiver.connected()) break;
+  }
+  if (report <= 0) receiver.print(std::cout);
+  return 0;
+}
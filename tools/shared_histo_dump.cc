@@ -0,0 +1,75 @@
+// Read the histograms TrackerDQM exports in shared memory (sharedMemory
+// parameter) and report each update: its number, age and total entries, and
+// with --list the entries of every histogram.
+//
+//   shared_histo_dump /trackerDQM [--seconds S] [--interval S] [--list]
+
+#include "otsdaq-mu2e-dqm-tracker/ArtModules/SharedHistoExport.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argv[1][0] != '/') {
+    std::fprintf(stderr, "usage: %s /NAME [--seconds S] [--interval S] [--list]\n", argv[0]);
+    return 1;
+  }
+  std::string name     = argv[1];
+  double      seconds  = 10.;
+  double      interval = 1.;
+  bool        list     = false;
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--seconds" && i + 1 < argc) seconds = std::atof(argv[++i]);
+    else if (arg == "--interval" && i + 1 < argc) interval = std::atof(argv[++i]);
+    else if (arg == "--list") list = true;
+    else {
+      std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return 1;
+    }
+  }
+
+  ots::SharedHisto::Reader reader;
+  if (!reader.open(name)) {
+    std::fprintf(stderr, "no complete shared-memory export named %s\n", name.c_str());
+    return 1;
+  }
+  std::printf("%s: %zu histograms, %llu bytes\n", name.c_str(), reader.size(),
+	      (unsigned long long)reader.header().segmentBytes);
+
+  auto     end  = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  uint64_t last = 0;
+  uint64_t torn = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    uint64_t update = 0;
+    int64_t  publishNs = 0;
+    double   entries = 0;
+    // views are only trusted once read() confirms the slot was not rewritten
+    std::vector<double> perHisto(list ? reader.size() : 0);
+    bool ok = reader.read([&](size_t i, const ots::SharedHisto::View& view) {
+	entries += view.stats[0];
+	if (list) perHisto[i] = view.stats[0];
+      }, &update, &publishNs);
+    if (!ok) {
+      if (reader.published() > 0) ++torn;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    if (update != last) {
+      int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+      std::printf("update %llu  age %.3f ms  entries %.0f  (torn reads %llu)\n", (unsigned long long)update,
+		  (nowNs - publishNs) * 1e-6, entries, (unsigned long long)torn);
+      for (size_t i = 0; i < perHisto.size(); ++i) {
+	std::printf("  %s/%s %.0f\n", reader.entry(i).group, reader.entry(i).name, perHisto[i]);
+      }
+      last = update;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+  }
+  return 0;
+}